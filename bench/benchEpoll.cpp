@@ -0,0 +1,92 @@
+#include "epoll_wrapper/Epoll.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+using namespace epoll_wrapper;
+
+// Keeps PIPES pipes permanently readable and measures the cost of turning
+// the ready set into results, per reported event.
+
+struct Fd
+{
+    int32_t fd;
+
+    int32_t getFileDescriptor() const
+    {
+        return fd;
+    }
+};
+
+constexpr int PIPES = 32;
+constexpr int ROUNDS = 200000;
+
+template <typename WaitFn>
+void run(const char* name, WaitFn&& waitOnce)
+{
+    // Warm up caches and the registry
+    for (int i = 0; i < 1000; ++i)
+    {
+        waitOnce();
+    }
+
+    std::size_t events = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < ROUNDS; ++i)
+    {
+        events += waitOnce();
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+    std::cout << name << ": " << static_cast<double>(ns) / events << " ns/event ("
+              << events << " events)" << std::endl;
+}
+
+int main()
+{
+    auto createEpoll = Epoll<Fd>::epollCreate();
+
+    if (!createEpoll)
+    {
+        std::cerr << "epoll_create failed: " << createEpoll.getError() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto& epoll = createEpoll.getEpoll();
+
+    for (int i = 0; i < PIPES; ++i)
+    {
+        int fds[2];
+        if (pipe(fds) != 0 || write(fds[1], "x", 1) != 1)
+        {
+            std::cerr << "pipe setup failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        epoll.add(Fd{fds[0]}, EventCode::EpollIn);
+    }
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+    std::cout << "header-only" << std::endl;
+#else
+    std::cout << "compiled library" << std::endl;
+#endif
+
+    run("wait()", [&epoll] {
+        return epoll.wait(0).getEvents().size();
+    });
+
+    EventBatch batch(PIPES);
+    run("wait(EventBatch&)", [&epoll, &batch] {
+        epoll.wait(batch, 0);
+        return batch.getReadable().size();
+    });
+
+    return EXIT_SUCCESS;
+}
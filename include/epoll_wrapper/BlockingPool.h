@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Config.h"
+#include "Error.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace epoll_wrapper
+{
+    class BufferPool;
+
+    // Storage borrowed from a BufferPool, handed back when destroyed.
+    // The pool must outlive every buffer acquired from it.
+    class Buffer
+    {
+        public:
+            Buffer() = default;
+            Buffer(BufferPool* pool, std::vector<char>&& storage);
+            ~Buffer();
+
+            Buffer(Buffer&&) noexcept;
+            Buffer& operator=(Buffer&&) noexcept;
+            Buffer(const Buffer&) = delete;
+            Buffer& operator=(const Buffer&) = delete;
+
+            char* data();
+            const char* data() const;
+            std::size_t size() const;
+            void resize(std::size_t size);
+
+        private:
+            BufferPool* mPool{nullptr};
+            std::vector<char> mStorage;
+
+            void release();
+    };
+
+    class BufferPool
+    {
+        public:
+            BufferPool(std::size_t maxFree);
+
+            Buffer acquire(std::size_t size);
+
+            std::size_t available() const;
+
+        private:
+            friend class Buffer;
+
+            mutable std::mutex mMutex;
+            std::vector<std::vector<char>> mFree;
+            std::size_t mMaxFree;
+
+            void release(std::vector<char>&& storage);
+    };
+
+    struct Completion
+    {
+        uint64_t mId;
+        ssize_t mResult;
+        // Only epoll errnos have an ErrorCode; mErrno keeps the exact cause
+        // (EIO, EISDIR, ENOSPC, ...). Both are zero on success.
+        ErrorCode mError;
+        int mErrno;
+        // Bytes read by submitRead, or the buffer passed to submitWrite
+        Buffer mBuffer;
+    };
+
+    // Runs blocking calls (regular-file I/O in particular, which epoll cannot
+    // watch) on worker threads. Completions are signalled through an eventfd:
+    // register getFileDescriptor() for EpollIn and call drain() when it fires.
+    class BlockingPool
+    {
+        public:
+            // Returns nullptr and leaves errno set if the eventfd cannot be created
+            static std::unique_ptr<BlockingPool> create(std::size_t threads, std::size_t maxQueued, std::size_t maxFreeBuffers = 64);
+
+            // Stops the workers; jobs that have not started are dropped
+            ~BlockingPool();
+
+            BlockingPool(const BlockingPool&) = delete;
+            BlockingPool& operator=(const BlockingPool&) = delete;
+
+            // Each submit returns false when maxQueued jobs are already waiting
+            bool submitRead(uint64_t id, int fd, off_t offset, std::size_t size);
+            bool submitWrite(uint64_t id, int fd, off_t offset, Buffer&& buffer);
+            // call returns a negative value and sets errno on failure
+            bool submit(uint64_t id, std::function<ssize_t()> call);
+
+            // Never blocks; returns every job finished since the last drain
+            std::vector<Completion> drain();
+
+            BufferPool& getBuffers();
+            int getFileDescriptor() const;
+
+        private:
+            struct Job
+            {
+                uint64_t mId;
+                std::function<ssize_t(Buffer&)> mCall;
+                Buffer mBuffer;
+            };
+
+            int mEventFd;
+            std::size_t mMaxQueued;
+            BufferPool mBuffers;
+
+            std::mutex mJobsMutex;
+            std::condition_variable mJobsCv;
+            std::deque<Job> mJobs;
+            bool mStopping{false};
+
+            std::mutex mDoneMutex;
+            std::vector<Completion> mDone;
+
+            std::vector<std::thread> mWorkers;
+
+            BlockingPool(int eventFd, std::size_t threads, std::size_t maxQueued, std::size_t maxFreeBuffers);
+
+            bool push(Job&& job);
+            void run();
+    };
+}
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#include "impl/BlockingPool.ipp"
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+// Define EPOLL_WRAPPER_HEADER_ONLY to use the library without linking it: every
+// header then pulls in its impl/*.ipp and the definitions become inline.
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#  define EPOLL_WRAPPER_DECL inline
+#else
+#  define EPOLL_WRAPPER_DECL
+#endif
@@ -2,10 +2,21 @@
 
 #include "Error.h"
 #include "Event.h"
+#include "EventBatch.h"
+#include "Handoff.h"
+#include "WriteQueue.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <map>
 #include <memory>
 #include <optional>
+#include <type_traits>
 #include <sys/epoll.h>
 #include <unistd.h>
 #include <unordered_map>
@@ -53,15 +64,28 @@ namespace epoll_wrapper
     {
         public:
             WaitAction(std::vector<std::pair<const FdType&, Event>>&&, ErrorCode);
+            WaitAction(std::vector<std::pair<const FdType&, Event>>&&,
+                       std::vector<std::reference_wrapper<const FdType>>&&,
+                       std::vector<std::reference_wrapper<const FdType>>&&,
+                       ErrorCode);
 
             const std::vector<std::pair<const FdType&, Event>>& getEvents() const;
 
+            // Registrations whose idle timeout elapsed during this wait
+            const std::vector<std::reference_wrapper<const FdType>>& getExpired() const;
+
+            // Registrations whose write queue drained below the low watermark
+            // after send() reported backpressure
+            const std::vector<std::reference_wrapper<const FdType>>& getWritable() const;
+
             bool hasError() const;
 
             ErrorCode getError() const;
 
         private:
             std::vector<std::pair<const FdType&, Event>> mEvents;
+            std::vector<std::reference_wrapper<const FdType>> mExpired;
+            std::vector<std::reference_wrapper<const FdType>> mWritable;
             ErrorCode mErrc;
     };
 
@@ -71,12 +95,17 @@ namespace epoll_wrapper
         
     public:
         static CreateAction<EpollImpl<EpollType, FdType>> epollCreate();
+        // Adopts an already constructed backend, e.g. a Recorder or Replay
+        static CreateAction<EpollImpl<EpollType, FdType>> epollCreate(std::unique_ptr<EpollType> epoll);
 
         EpollImpl(const EpollImpl&) = delete;
         EpollImpl& operator=(const EpollImpl&) = delete;
         EpollImpl& operator=(EpollImpl&&) = delete;
 
         WaitAction<FdType> wait(uint32_t timeout = -1);
+        // Fills batch instead of building the event vector; idle expiry and
+        // write queue drains are still reported through the WaitAction.
+        WaitAction<FdType> wait(EventBatch& batch, uint32_t timeout = -1);
 
         CtlAction add(const FdType& fd, EventCode event);
         CtlAction add(const FdType& fd, EventCodeMask event);
@@ -85,6 +114,31 @@ namespace epoll_wrapper
         CtlAction erase(const FdType& fd);
         void close();
 
+        // Arms an inactivity deadline for a registered fd. The deadline is pushed
+        // back whenever wait() reports an event on the fd; once it elapses the fd
+        // is reported once through WaitAction::getExpired() and disarmed.
+        CtlAction setIdleTimeout(const FdType& fd, std::chrono::milliseconds timeout);
+        CtlAction clearIdleTimeout(const FdType& fd);
+
+        // Queues data for a registered non-blocking fd. EpollOut interest is
+        // only enabled while bytes are pending and wait() flushes them; the
+        // EpollOut events it adds are not reported unless subscribed to.
+        SendAction send(const FdType& fd, const char* data, std::size_t size);
+        CtlAction setWatermarks(const FdType& fd, std::size_t lowWatermark, std::size_t highWatermark);
+        std::size_t getQueued(const FdType& fd) const;
+
+        // Snapshot of every registration for handing off to another process.
+        // tagOf maps an FdType to the tag stored alongside its fd and mask.
+        // Queued send() bytes stay in this process; mQueued reports how many
+        // so the caller can flush them before handing the fds over.
+        template <typename TagFn>
+        std::vector<Registration> exportRegistry(TagFn&& tagOf) const;
+
+        // Registers every entry, building each FdType with makeFd(fd, tag).
+        // Entries that fail are skipped; the first error is returned.
+        template <typename MakeFdFn>
+        CtlAction importRegistry(const std::vector<Registration>& registrations, MakeFdFn&& makeFd);
+
         EpollType& getUnderlying() const;
         bool hasFd(uint32_t fd) const;
         const FdType& getFd(uint32_t fd) const;
@@ -93,14 +147,61 @@ namespace epoll_wrapper
     private:
         static constexpr uint32_t MAXEVENTS = 32;
 
+        using Clock = std::chrono::steady_clock;
+
+        struct IdleEntry
+        {
+            uint32_t mFd;
+            Clock::time_point mDeadline;
+        };
+
+        // One list per distinct timeout, so every list stays sorted by deadline
+        // and refreshing an entry is a splice to the back.
+        using IdleList = std::list<IdleEntry>;
+
+        struct IdleHandle
+        {
+            std::chrono::milliseconds mTimeout;
+            IdleList* mList;
+            typename IdleList::iterator mIt;
+        };
+
         int32_t mTimeout{-1};
         // uint32_t is the underlying file descriptor
         std::unordered_map<uint32_t, EventCodeMask> mRegisteredEvents;
         std::unordered_map<uint32_t, FdType> mRegisteredFds;
+        std::map<std::chrono::milliseconds, IdleList> mIdleLists;
+        std::unordered_map<uint32_t, IdleHandle> mIdleEntries;
+        std::unordered_map<uint32_t, WriteQueue> mWriteQueues;
         struct epoll_event mEvents[MAXEVENTS];
 
         std::unique_ptr<EpollType> mEpoll;
 
         EpollImpl(std::unique_ptr<EpollType> epoll);
+
+        // FdType is either an integral fd or exposes getFileDescriptor()
+        static int32_t fileDescriptorOf(const FdType& fdObj);
+
+        int32_t idleWaitTimeout(uint32_t timeout) const;
+        void touchIdle(uint32_t fd, Clock::time_point now);
+        void eraseIdle(uint32_t fd);
+        std::vector<std::reference_wrapper<const FdType>> expireIdle(Clock::time_point now);
+
+        EventCodeMask withWriteInterest(uint32_t fd, EventCodeMask eventc) const;
+        CtlAction updateWriteInterest(uint32_t fd);
+        ErrorCode flushWriteQueue(uint32_t fd, const FdType& fdObj, std::vector<std::reference_wrapper<const FdType>>& writable);
 };
-}
\ No newline at end of file
+}
+
+#include "EpollImpl.ipp"
+
+#if defined(EPOLL_WRAPPER_EXTERN_TEMPLATES)
+#include "Light.h"
+
+namespace epoll_wrapper
+{
+    // Instantiated once in the compiled library, see src/epoll_wrapper/EpollImpl.cpp
+    extern template class WaitAction<int>;
+    extern template class EpollImpl<Light, int>;
+}
+#endif
@@ -1,3 +1,5 @@
+#pragma once
+
 #include "Epoll.h"
 #include "EpollImpl.h"
 #include "Event.h"
@@ -40,14 +42,14 @@ namespace epoll_wrapper
         return *mEpoll;
     }
 
-    CtlAction::CtlAction(ErrorCode errc) : mErrc(errc) {}
+    inline CtlAction::CtlAction(ErrorCode errc) : mErrc(errc) {}
     
-    bool CtlAction::hasError() const
+    inline bool CtlAction::hasError() const
     {
         return mErrc != ErrorCode::None;
     }
 
-    ErrorCode CtlAction::getError() const
+    inline ErrorCode CtlAction::getError() const
     {
         return mErrc;
     }
@@ -56,12 +58,34 @@ namespace epoll_wrapper
     WaitAction<FdType>::WaitAction(std::vector<std::pair<const FdType&, Event>>&& events, ErrorCode errc)
         : mEvents(std::move(events)), mErrc(errc) {}
 
+    template <typename FdType>
+    WaitAction<FdType>::WaitAction(std::vector<std::pair<const FdType&, Event>>&& events
+                                  , std::vector<std::reference_wrapper<const FdType>>&& expired
+                                  , std::vector<std::reference_wrapper<const FdType>>&& writable
+                                  , ErrorCode errc)
+        : mEvents(std::move(events))
+        , mExpired(std::move(expired))
+        , mWritable(std::move(writable))
+        , mErrc(errc) {}
+
     template <typename FdType>
     const std::vector<std::pair<const FdType&, Event>>& WaitAction<FdType>::getEvents() const
     {
         return mEvents;
     }
 
+    template <typename FdType>
+    const std::vector<std::reference_wrapper<const FdType>>& WaitAction<FdType>::getExpired() const
+    {
+        return mExpired;
+    }
+
+    template <typename FdType>
+    const std::vector<std::reference_wrapper<const FdType>>& WaitAction<FdType>::getWritable() const
+    {
+        return mWritable;
+    }
+
     template <typename FdType>
     bool WaitAction<FdType>::hasError() const
     {
@@ -79,9 +103,14 @@ namespace epoll_wrapper
 
     template <typename EpollType, typename FdType>
     CreateAction<EpollImpl<EpollType, FdType>> EpollImpl<EpollType, FdType>::epollCreate()
+    {
+        return epollCreate(EpollType::epoll_create(1));
+    }
+
+    template <typename EpollType, typename FdType>
+    CreateAction<EpollImpl<EpollType, FdType>> EpollImpl<EpollType, FdType>::epollCreate(std::unique_ptr<EpollType> epollFd)
     {
         using Epoll = EpollImpl<EpollType, FdType>;
-        auto epollFd = EpollType::epoll_create(1);
 
         if (epollFd)
         {
@@ -93,43 +122,154 @@ namespace epoll_wrapper
         return CreateAction<Epoll>(nullptr, fromEpollError(errno));
     }
 
+    template <typename EpollType, typename FdType>
+    int32_t EpollImpl<EpollType, FdType>::fileDescriptorOf(const FdType& fdObj)
+    {
+        if constexpr (std::is_integral_v<FdType>)
+        {
+            return fdObj;
+        }
+        else
+        {
+            return fdObj.getFileDescriptor();
+        }
+    }
+
     template <typename EpollType, typename FdType>
     void EpollImpl<EpollType, FdType>::close()
     {
-        mEpoll.release();
+        if (mEpoll)
+        {
+            mEpoll->close();
+            mEpoll.reset();
+        }
     }
 
     template <typename EpollType, typename FdType>
     WaitAction<FdType> EpollImpl<EpollType, FdType>::wait(uint32_t timeout)
     {
         struct epoll_event events[MAXEVENTS];
-        auto resultCode = mEpoll->epoll_wait(events, MAXEVENTS, timeout);
+        auto resultCode = mEpoll->epoll_wait(events, MAXEVENTS, idleWaitTimeout(timeout));
+        auto waitErrno = errno;
+        auto now = Clock::now();
 
         std::vector<std::pair<const FdType&, Event>> eventVector;
+        std::vector<std::reference_wrapper<const FdType>> writable;
         int i = 0;
 
         ErrorCode waErr{ErrorCode::None};
 
         if (resultCode < 0)
         {
-            waErr = fromEpollError(errno);
+            waErr = fromEpollError(waitErrno);
         }
 
         while (i < resultCode)
         {
-            Event ev{fromEpollEvent(events[i].events), fromEpollError(errno), std::move(events[i].data)};
+            Event ev{fromEpollEvent(events[i].events), fromEpollError(waitErrno), events[i].data};
 
             // Reserve event vector
             if (auto it = mRegisteredFds.find(events[i].data.fd); it != mRegisteredFds.end())
             {
-                std::pair<const FdType&, Event> p = {it->second, std::move(ev)};
-                eventVector.emplace_back(std::move(p));
+                touchIdle(it->first, now);
+
+                bool flushFailed = false;
+                if (ev.mEvents & (EventCode::EpollOut | EventCode::EpollErr | EventCode::EpollHUp))
+                {
+                    if (auto flushErr = flushWriteQueue(it->first, it->second, writable); flushErr != ErrorCode::None)
+                    {
+                        ev.mError = flushErr;
+                        flushFailed = true;
+                    }
+                }
+
+                // Hide the EpollOut interest we added on the user's behalf
+                if (!(mRegisteredEvents[it->first] & EventCode::EpollOut))
+                {
+                    ev.mEvents = ev.mEvents & ~static_cast<EventCodeMask>(EventCode::EpollOut);
+                }
+
+                if (ev.mEvents != 0 || flushFailed)
+                {
+                    std::pair<const FdType&, Event> p = {it->second, std::move(ev)};
+                    eventVector.emplace_back(std::move(p));
+                }
             }
             
             ++i;
         }
         
-        return WaitAction<FdType>{std::move(eventVector), waErr};
+        return WaitAction<FdType>{std::move(eventVector), expireIdle(now), std::move(writable), waErr};
+    }
+
+    template <typename EpollType, typename FdType>
+    WaitAction<FdType> EpollImpl<EpollType, FdType>::wait(EventBatch& batch, uint32_t timeout)
+    {
+        auto resultCode = mEpoll->epoll_wait(batch.getRaw(), batch.capacity(), idleWaitTimeout(timeout));
+        auto waitErrno = errno;
+        auto now = Clock::now();
+
+        std::vector<std::reference_wrapper<const FdType>> writable;
+
+        if (resultCode < 0)
+        {
+            batch.assign(0);
+            return WaitAction<FdType>{{}, expireIdle(now), {}, fromEpollError(waitErrno)};
+        }
+
+        batch.assign(resultCode);
+
+        if (!mIdleEntries.empty())
+        {
+            for (auto fd : batch.mFds)
+            {
+                touchIdle(fd, now);
+            }
+        }
+
+        if (!mWriteQueues.empty())
+        {
+            // Same triggers as wait(): errors and hangups flush too, so a dead
+            // peer clears its queue and drops the write interest we armed
+            std::vector<uint32_t> candidates;
+            candidates.reserve(batch.mWritable.size() + batch.mErrors.size());
+            std::set_union(batch.mWritable.begin(), batch.mWritable.end(),
+                           batch.mErrors.begin(), batch.mErrors.end(),
+                           std::back_inserter(candidates));
+
+            bool changed = false;
+
+            for (auto idx : candidates)
+            {
+                auto fd = batch.mFds[idx];
+                auto it = mRegisteredFds.find(fd);
+
+                if (it == mRegisteredFds.end())
+                {
+                    continue;
+                }
+
+                if (flushWriteQueue(fd, it->second, writable) != ErrorCode::None)
+                {
+                    batch.mMasks[idx] |= EPOLLERR;
+                    changed = true;
+                }
+
+                // Hide the EpollOut interest we added on the user's behalf
+                if ((batch.mMasks[idx] & EPOLLOUT) && !(mRegisteredEvents[fd] & EventCode::EpollOut))
+                {
+                    batch.mMasks[idx] &= ~static_cast<uint32_t>(EPOLLOUT);
+                    changed = true;
+                }
+            }
+
+            if (changed)
+            {
+                batch.compact();
+            }
+        }
+
+        return WaitAction<FdType>{{}, expireIdle(now), std::move(writable), ErrorCode::None};
     }
 
     template <typename EpollType, typename FdType>
@@ -141,7 +281,7 @@ namespace epoll_wrapper
     template <typename EpollType, typename FdType>
     CtlAction EpollImpl<EpollType, FdType>::add(const FdType& fdObj, EventCodeMask eventc)
     {
-        auto fd = fdObj.getFileDescriptor();
+        auto fd = fileDescriptorOf(fdObj);
         
         struct epoll_event event;
         event.events = toEpollEvent(eventc);
@@ -174,7 +314,7 @@ namespace epoll_wrapper
     template <typename EpollType, typename FdType>
     CtlAction EpollImpl<EpollType, FdType>::mod(const FdType& fdObj, EventCodeMask eventc)
     {
-        auto fd = fdObj.getFileDescriptor();
+        auto fd = fileDescriptorOf(fdObj);
 
         if (mRegisteredFds.find(fd) == mRegisteredFds.end())
         {
@@ -182,7 +322,7 @@ namespace epoll_wrapper
         }
 
         struct epoll_event event;
-        event.events = toEpollEvent(eventc);
+        event.events = toEpollEvent(withWriteInterest(fd, eventc));
         event.data.fd = fd;
         
         auto res = mEpoll->epoll_ctl(EPOLL_CTL_MOD, fd, &event);
@@ -199,13 +339,15 @@ namespace epoll_wrapper
     template <typename EpollType, typename FdType>
     CtlAction EpollImpl<EpollType, FdType>::erase(const FdType& fdObj)
     {
-        auto fd = fdObj.getFileDescriptor();
+        auto fd = fileDescriptorOf(fdObj);
 
         struct epoll_event event;
         auto res = mEpoll->epoll_ctl(EPOLL_CTL_DEL, fd, &event);
 
         if (res == 0)
         {
+            eraseIdle(fd);
+            mWriteQueues.erase(fd);
             mRegisteredEvents.erase(fd);
             mRegisteredFds.erase(fd);
             return CtlAction{ErrorCode::None};
@@ -213,6 +355,314 @@ namespace epoll_wrapper
 
         return CtlAction{fromEpollError(errno)};
     }
+
+    template <typename EpollType, typename FdType>
+    CtlAction EpollImpl<EpollType, FdType>::setIdleTimeout(const FdType& fdObj, std::chrono::milliseconds timeout)
+    {
+        auto fd = fileDescriptorOf(fdObj);
+
+        if (mRegisteredFds.find(fd) == mRegisteredFds.end())
+        {
+            return CtlAction{ErrorCode::EnoEnt};
+        }
+
+        if (timeout.count() <= 0)
+        {
+            return CtlAction{ErrorCode::Einval};
+        }
+
+        eraseIdle(fd);
+
+        auto& list = mIdleLists[timeout];
+        auto it = list.insert(list.end(), IdleEntry{static_cast<uint32_t>(fd), Clock::now() + timeout});
+        mIdleEntries.insert({fd, IdleHandle{timeout, &list, it}});
+
+        return CtlAction{ErrorCode::None};
+    }
+
+    template <typename EpollType, typename FdType>
+    CtlAction EpollImpl<EpollType, FdType>::clearIdleTimeout(const FdType& fdObj)
+    {
+        auto fd = fileDescriptorOf(fdObj);
+
+        if (mIdleEntries.find(fd) == mIdleEntries.end())
+        {
+            return CtlAction{ErrorCode::EnoEnt};
+        }
+
+        eraseIdle(fd);
+        return CtlAction{ErrorCode::None};
+    }
+
+    template <typename EpollType, typename FdType>
+    SendAction EpollImpl<EpollType, FdType>::send(const FdType& fdObj, const char* data, std::size_t size)
+    {
+        auto fd = fileDescriptorOf(fdObj);
+
+        if (mRegisteredFds.find(fd) == mRegisteredFds.end())
+        {
+            return SendAction{ErrorCode::EnoEnt, false};
+        }
+
+        auto& queue = mWriteQueues[fd];
+        bool wasEmpty = queue.empty();
+
+        if (auto err = queue.send(fd, data, size); err != ErrorCode::None)
+        {
+            queue.clear();
+            return SendAction{err, false};
+        }
+
+        if (wasEmpty && !queue.empty())
+        {
+            if (auto ctl = updateWriteInterest(fd); ctl.hasError())
+            {
+                queue.clear();
+                return SendAction{ctl.getError(), false};
+            }
+        }
+
+        return SendAction{ErrorCode::None, queue.isPaused()};
+    }
+
+    template <typename EpollType, typename FdType>
+    CtlAction EpollImpl<EpollType, FdType>::setWatermarks(const FdType& fdObj, std::size_t lowWatermark, std::size_t highWatermark)
+    {
+        auto fd = fileDescriptorOf(fdObj);
+
+        if (mRegisteredFds.find(fd) == mRegisteredFds.end())
+        {
+            return CtlAction{ErrorCode::EnoEnt};
+        }
+
+        if (lowWatermark > highWatermark)
+        {
+            return CtlAction{ErrorCode::Einval};
+        }
+
+        mWriteQueues[fd].setWatermarks(lowWatermark, highWatermark);
+        return CtlAction{ErrorCode::None};
+    }
+
+    template <typename EpollType, typename FdType>
+    std::size_t EpollImpl<EpollType, FdType>::getQueued(const FdType& fdObj) const
+    {
+        auto it = mWriteQueues.find(fileDescriptorOf(fdObj));
+
+        if (it != mWriteQueues.end())
+        {
+            return it->second.size();
+        }
+
+        return 0;
+    }
+
+    template <typename EpollType, typename FdType>
+    template <typename TagFn>
+    std::vector<Registration> EpollImpl<EpollType, FdType>::exportRegistry(TagFn&& tagOf) const
+    {
+        std::vector<Registration> registrations;
+        registrations.reserve(mRegisteredFds.size());
+
+        for (const auto& [fd, fdObj] : mRegisteredFds)
+        {
+            auto queue = mWriteQueues.find(fd);
+            uint64_t queued = queue != mWriteQueues.end() ? queue->second.size() : 0;
+
+            registrations.push_back(Registration{static_cast<int32_t>(fd), mRegisteredEvents.at(fd), tagOf(fdObj), queued});
+        }
+
+        return registrations;
+    }
+
+    template <typename EpollType, typename FdType>
+    template <typename MakeFdFn>
+    CtlAction EpollImpl<EpollType, FdType>::importRegistry(const std::vector<Registration>& registrations, MakeFdFn&& makeFd)
+    {
+        mRegisteredFds.reserve(mRegisteredFds.size() + registrations.size());
+        mRegisteredEvents.reserve(mRegisteredEvents.size() + registrations.size());
+
+        auto ec = ErrorCode::None;
+
+        for (const auto& reg : registrations)
+        {
+            auto res = add(makeFd(reg.mFd, reg.mTag), reg.mEvents);
+
+            if (res.hasError() && ec == ErrorCode::None)
+            {
+                ec = res.getError();
+            }
+        }
+
+        return CtlAction{ec};
+    }
+
+    template <typename EpollType, typename FdType>
+    EventCodeMask EpollImpl<EpollType, FdType>::withWriteInterest(uint32_t fd, EventCodeMask eventc) const
+    {
+        if (auto it = mWriteQueues.find(fd); it != mWriteQueues.end() && !it->second.empty())
+        {
+            return eventc | EventCode::EpollOut;
+        }
+
+        return eventc;
+    }
+
+    template <typename EpollType, typename FdType>
+    CtlAction EpollImpl<EpollType, FdType>::updateWriteInterest(uint32_t fd)
+    {
+        auto registered = mRegisteredEvents[fd];
+
+        // The user already listens for EpollOut, so the kernel mask is unchanged
+        if (registered & EventCode::EpollOut)
+        {
+            return CtlAction{ErrorCode::None};
+        }
+
+        struct epoll_event event;
+        event.events = toEpollEvent(withWriteInterest(fd, registered));
+        event.data.fd = fd;
+
+        if (mEpoll->epoll_ctl(EPOLL_CTL_MOD, fd, &event) == 0)
+        {
+            return CtlAction{ErrorCode::None};
+        }
+
+        return CtlAction{fromEpollError(errno)};
+    }
+
+    template <typename EpollType, typename FdType>
+    ErrorCode EpollImpl<EpollType, FdType>::flushWriteQueue(uint32_t fd, const FdType& fdObj, std::vector<std::reference_wrapper<const FdType>>& writable)
+    {
+        auto it = mWriteQueues.find(fd);
+
+        if (it == mWriteQueues.end() || it->second.empty())
+        {
+            return ErrorCode::None;
+        }
+
+        auto& queue = it->second;
+        bool wasPaused = queue.isPaused();
+
+        auto err = queue.flush(fd);
+
+        if (err != ErrorCode::None)
+        {
+            queue.clear();
+        }
+        else if (wasPaused && !queue.isPaused())
+        {
+            writable.emplace_back(fdObj);
+        }
+
+        if (queue.empty())
+        {
+            updateWriteInterest(fd);
+        }
+
+        return err;
+    }
+
+    template <typename EpollType, typename FdType>
+    int32_t EpollImpl<EpollType, FdType>::idleWaitTimeout(uint32_t timeout) const
+    {
+        auto waitTimeout = static_cast<int32_t>(timeout);
+
+        std::optional<Clock::time_point> nearest;
+        for (const auto& [_, list] : mIdleLists)
+        {
+            if (!list.empty() && (!nearest || list.front().mDeadline < *nearest))
+            {
+                nearest = list.front().mDeadline;
+            }
+        }
+
+        if (!nearest)
+        {
+            return waitTimeout;
+        }
+
+        // Round up so we never wake just before the deadline and spin
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*nearest - Clock::now()).count();
+        if (remaining < 0)
+        {
+            remaining = 0;
+        }
+        else if (remaining > std::numeric_limits<int32_t>::max())
+        {
+            // epoll_wait takes an int; wake early and recompute
+            remaining = std::numeric_limits<int32_t>::max();
+        }
+
+        if (waitTimeout < 0 || remaining < waitTimeout)
+        {
+            return static_cast<int32_t>(remaining);
+        }
+
+        return waitTimeout;
+    }
+
+    template <typename EpollType, typename FdType>
+    void EpollImpl<EpollType, FdType>::touchIdle(uint32_t fd, Clock::time_point now)
+    {
+        if (mIdleEntries.empty())
+        {
+            return;
+        }
+
+        if (auto it = mIdleEntries.find(fd); it != mIdleEntries.end())
+        {
+            auto& handle = it->second;
+            handle.mIt->mDeadline = now + handle.mTimeout;
+            handle.mList->splice(handle.mList->end(), *handle.mList, handle.mIt);
+        }
+    }
+
+    template <typename EpollType, typename FdType>
+    void EpollImpl<EpollType, FdType>::eraseIdle(uint32_t fd)
+    {
+        if (auto it = mIdleEntries.find(fd); it != mIdleEntries.end())
+        {
+            auto& handle = it->second;
+            handle.mList->erase(handle.mIt);
+
+            // Drop emptied lists so waits only walk timeouts still in use
+            if (handle.mList->empty())
+            {
+                mIdleLists.erase(handle.mTimeout);
+            }
+
+            mIdleEntries.erase(it);
+        }
+    }
+
+    template <typename EpollType, typename FdType>
+    std::vector<std::reference_wrapper<const FdType>> EpollImpl<EpollType, FdType>::expireIdle(Clock::time_point now)
+    {
+        std::vector<std::reference_wrapper<const FdType>> expired;
+
+        for (auto listIt = mIdleLists.begin(); listIt != mIdleLists.end();)
+        {
+            auto& list = listIt->second;
+
+            while (!list.empty() && list.front().mDeadline <= now)
+            {
+                auto fd = list.front().mFd;
+
+                if (auto it = mRegisteredFds.find(fd); it != mRegisteredFds.end())
+                {
+                    expired.emplace_back(it->second);
+                }
+
+                mIdleEntries.erase(fd);
+                list.pop_front();
+            }
+
+            listIt = list.empty() ? mIdleLists.erase(listIt) : std::next(listIt);
+        }
+
+        return expired;
+    }
         
     template <typename EpollType, typename FdType>
     EpollType& EpollImpl<EpollType, FdType>::getUnderlying() const
@@ -229,6 +679,7 @@ namespace epoll_wrapper
     template <typename EpollType, typename FdType>
     const FdType& EpollImpl<EpollType, FdType>::getFd(uint32_t fd) const
     {
+        static const FdType empty{};
         auto it = mRegisteredFds.find(fd);
 
         if (it != mRegisteredFds.end())
@@ -236,13 +687,13 @@ namespace epoll_wrapper
             return it->second;
         }
 
-        return {};
+        return empty;
     }
     
     template <typename EpollType, typename FdType>
     const EventCodeMask EpollImpl<EpollType, FdType>::getEvents(const FdType& fdObj) const
     {
-        auto it  = mRegisteredEvents.find(fdObj.getFileDescriptor());
+        auto it  = mRegisteredEvents.find(fileDescriptorOf(fdObj));
 
         if (it != mRegisteredEvents.end())
         {
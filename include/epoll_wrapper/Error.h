@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Config.h"
+
 #include <ostream>
 #include <sys/types.h>
 
@@ -21,6 +23,7 @@ namespace epoll_wrapper
         , Eintr   = 1u << 10
         , EmFile  = 1u << 11
         , EnFile  = 1u << 12 
+        , Epipe   = 1u << 13
         };
 
     std::ostream& operator<<(std::ostream&, const ErrorCode&);
@@ -36,4 +39,8 @@ namespace epoll_wrapper
 namespace std
 {
     std::string to_string(epoll_wrapper::ErrorCode c);
-}
\ No newline at end of file
+}
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#include "impl/Error.ipp"
+#endif
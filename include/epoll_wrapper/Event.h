@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Config.h"
 #include "Error.h"
 
 #include <ostream>
@@ -42,4 +43,8 @@ namespace epoll_wrapper
 
     int toEpollEvent(EventCodeMask event);
     EventCodeMask fromEpollEvent(int eventc);
-}
\ No newline at end of file
+}
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#include "impl/Event.ipp"
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/epoll.h>
+#include <vector>
+
+namespace epoll_wrapper
+{
+    template <typename EpollType, typename FdType>
+    class EpollImpl;
+
+    // Structure-of-arrays view of one epoll_wait batch. Fds and raw EPOLL* masks
+    // sit in parallel arrays, and the readable/writable/error lists hold indices
+    // into them, so handlers can run one tight loop per kind of readiness.
+    // Unlike WaitAction, entries are not resolved to FdType objects. As in
+    // WaitAction, events left empty once write queue interest is hidden are
+    // dropped, so size() only counts entries with a non-zero mask.
+    class EventBatch
+    {
+        public:
+            EventBatch(std::size_t capacity = 256);
+
+            std::size_t size() const;
+            std::size_t capacity() const;
+
+            const std::vector<uint32_t>& getFds() const;
+            const std::vector<uint32_t>& getMasks() const;
+
+            // EPOLLIN or EPOLLPRI
+            const std::vector<uint32_t>& getReadable() const;
+            // EPOLLOUT
+            const std::vector<uint32_t>& getWritable() const;
+            // EPOLLERR or EPOLLHUP
+            const std::vector<uint32_t>& getErrors() const;
+
+            // Rebuilds the arrays from the first count entries of getRaw()
+            void assign(std::size_t count);
+
+            struct epoll_event* getRaw();
+
+        private:
+            template <typename EpollType, typename FdType>
+            friend class EpollImpl;
+
+            std::vector<struct epoll_event> mRaw;
+            std::vector<uint32_t> mFds;
+            std::vector<uint32_t> mMasks;
+            std::vector<uint32_t> mReadable;
+            std::vector<uint32_t> mWritable;
+            std::vector<uint32_t> mErrors;
+
+            // Drops entries whose mask was cleared and rebuilds the index lists
+            // from the (possibly edited) masks
+            void compact();
+    };
+}
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#include "impl/EventBatch.ipp"
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Config.h"
+#include "Error.h"
+#include "Event.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace epoll_wrapper
+{
+    // One exported registry entry. mTag is an application value used to
+    // rebuild the FdType on the receiving side. mQueued is the number of
+    // bytes still in the exporter's write queue; it is not sent over the
+    // socket, so received entries always read 0.
+    struct Registration
+    {
+        int32_t mFd;
+        EventCodeMask mEvents;
+        uint64_t mTag;
+        uint64_t mQueued;
+    };
+
+    // Largest number of fds the kernel accepts in one SCM_RIGHTS message
+    constexpr std::size_t HANDOFF_BATCH = 253;
+
+    // Passes registrations and their fds over a connected AF_UNIX SOCK_SEQPACKET
+    // socket, HANDOFF_BATCH fds per message. The sender keeps its own copies of
+    // the fds open; close them once the successor has taken over.
+    ErrorCode sendRegistrations(int socket, const std::vector<Registration>& registrations);
+
+    // Receives what sendRegistrations sent. The returned mFd values are the fd
+    // numbers in this process, opened with O_CLOEXEC. On error every fd
+    // received by this call is closed and registrations is left unchanged.
+    ErrorCode receiveRegistrations(int socket, std::vector<Registration>& registrations);
+}
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#include "impl/Handoff.ipp"
+#endif
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Config.h"
+
 #include <memory>
 #include <optional>
 #include <sys/epoll.h>
@@ -22,4 +24,8 @@ namespace epoll_wrapper
             void close();
             int getUnderlying() const;
     };
-}
\ No newline at end of file
+}
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#include "impl/Light.ipp"
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Config.h"
+#include "Light.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <sys/epoll.h>
+#include <vector>
+
+namespace epoll_wrapper
+{
+    // Trace files start with TRACE_MAGIC and TRACE_VERSION (u32 each), followed by
+    // records in host byte order. Each record is a u8 kind and a u64 timestamp in
+    // nanoseconds since the trace was opened, then:
+    //   Ctl:  i32 op, i32 fd, u32 events, i32 result, i32 errno
+    //   Wait: i32 timeout, i32 result, i32 errno, result x packed epoll_event
+    constexpr uint32_t TRACE_MAGIC = 0x54575045; // "EPWT"
+    constexpr uint32_t TRACE_VERSION = 1;
+
+    enum class TraceRecord : uint8_t
+        { Ctl  = 1
+        , Wait = 2
+        };
+
+    // EpollType policy that forwards to Light and logs every call to a trace
+    class Recorder
+    {
+        private:
+            std::unique_ptr<Light> mLight;
+            std::ofstream mTrace;
+            std::chrono::steady_clock::time_point mStart;
+
+            Recorder(std::unique_ptr<Light> light, std::ofstream&& trace);
+
+            void writeHeader(TraceRecord kind);
+
+        public:
+            // Returns nullptr and leaves errno set if the trace cannot be created
+            static std::unique_ptr<Recorder> open(const std::string& path);
+
+            int epoll_ctl(int op, int fd, struct epoll_event *event);
+            int epoll_wait(struct epoll_event *events, int maxevents, int timeout);
+            void close();
+            void flush();
+            int getUnderlying() const;
+    };
+
+    // EpollType policy that plays a recorded trace back without touching the
+    // kernel. Waits return the recorded batches immediately, in order, ignoring
+    // timestamps; once the trace is exhausted every wait reports a timeout.
+    class Replay
+    {
+        private:
+            struct CtlRecord
+            {
+                int32_t mOp;
+                int32_t mFd;
+                int32_t mResult;
+                int32_t mErrno;
+            };
+
+            struct WaitRecord
+            {
+                int32_t mResult;
+                int32_t mErrno;
+                std::size_t mFirst;
+            };
+
+            std::vector<CtlRecord> mCtls;
+            std::vector<WaitRecord> mWaits;
+            std::vector<struct epoll_event> mEvents;
+            std::size_t mCtlPos{0};
+            std::size_t mWaitPos{0};
+            std::size_t mEventPos{0};
+            std::size_t mDivergences{0};
+
+            Replay() = default;
+
+        public:
+            static constexpr std::size_t RESYNC_WINDOW = 64;
+
+            // Loads the whole trace. Returns nullptr with errno set to EINVAL
+            // for a malformed trace, or the open error.
+            static std::unique_ptr<Replay> open(const std::string& path);
+
+            // Returns the recorded outcome of the next recorded call with the same
+            // op and fd. Recorded calls skipped to reach it, within RESYNC_WINDOW,
+            // count as divergences. A call with no match in the window succeeds,
+            // counts one divergence and leaves the position unchanged.
+            int epoll_ctl(int op, int fd, struct epoll_event *event);
+            int epoll_wait(struct epoll_event *events, int maxevents, int timeout);
+            void close();
+            int getUnderlying() const;
+
+            bool finished() const;
+            std::size_t getDivergences() const;
+    };
+}
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#include "impl/Trace.ipp"
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Config.h"
+#include "Error.h"
+
+#include <cstddef>
+#include <deque>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+namespace epoll_wrapper
+{
+    class SendAction
+    {
+        public:
+            SendAction(ErrorCode errc, bool backpressure);
+
+            bool hasError() const;
+
+            ErrorCode getError() const;
+
+            // True once the queue crossed its high watermark. Producers should
+            // hold off until the fd shows up in WaitAction::getWritable().
+            bool hasBackpressure() const;
+
+        private:
+            ErrorCode mErrc;
+            bool mBackpressure;
+    };
+
+    // Outbound bytes for a single non-blocking fd. Small writes are coalesced
+    // into shared chunks and flushed together with writev.
+    class WriteQueue
+    {
+        public:
+            static constexpr std::size_t DEFAULT_LOW_WATERMARK = 16 * 1024;
+            static constexpr std::size_t DEFAULT_HIGH_WATERMARK = 64 * 1024;
+            static constexpr std::size_t CHUNK_SIZE = 16 * 1024;
+
+            WriteQueue(std::size_t lowWatermark = DEFAULT_LOW_WATERMARK,
+                       std::size_t highWatermark = DEFAULT_HIGH_WATERMARK);
+
+            void setWatermarks(std::size_t lowWatermark, std::size_t highWatermark);
+
+            // Writes straight to fd while nothing is queued, queueing whatever
+            // would block. Only hard write errors are returned.
+            ErrorCode send(int fd, const char* data, std::size_t size);
+
+            // Writes queued bytes until the queue drains or fd would block.
+            ErrorCode flush(int fd);
+
+            void clear();
+
+            std::size_t size() const;
+            bool empty() const;
+
+            // Set when the high watermark is crossed, cleared once a flush
+            // brings the queue back down to the low watermark.
+            bool isPaused() const;
+
+        private:
+            std::deque<std::vector<char>> mChunks;
+            std::size_t mOffset{0};
+            std::size_t mSize{0};
+            std::size_t mLowWatermark;
+            std::size_t mHighWatermark;
+            bool mPaused{false};
+            // Cleared the first time send/sendmsg reports ENOTSOCK
+            bool mSocket{true};
+
+            // Sockets are written with MSG_NOSIGNAL so a closed peer yields
+            // EPIPE instead of SIGPIPE; other fds fall back to write/writev.
+            ssize_t writeOnce(int fd, const char* data, std::size_t size);
+            ssize_t writeVector(int fd, struct iovec* iov, int count);
+
+            void append(const char* data, std::size_t size);
+            void consume(std::size_t size);
+            void updatePaused();
+    };
+}
+
+#if defined(EPOLL_WRAPPER_HEADER_ONLY)
+#include "impl/WriteQueue.ipp"
+#endif
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "../BlockingPool.h"
+
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace epoll_wrapper
+{
+    EPOLL_WRAPPER_DECL Buffer::Buffer(BufferPool* pool, std::vector<char>&& storage)
+        : mPool(pool), mStorage(std::move(storage)) {}
+
+    EPOLL_WRAPPER_DECL Buffer::~Buffer()
+    {
+        release();
+    }
+
+    EPOLL_WRAPPER_DECL Buffer::Buffer(Buffer&& other) noexcept
+        : mPool(other.mPool), mStorage(std::move(other.mStorage))
+    {
+        other.mPool = nullptr;
+    }
+
+    EPOLL_WRAPPER_DECL Buffer& Buffer::operator=(Buffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            mPool = other.mPool;
+            mStorage = std::move(other.mStorage);
+            other.mPool = nullptr;
+        }
+
+        return *this;
+    }
+
+    EPOLL_WRAPPER_DECL char* Buffer::data()
+    {
+        return mStorage.data();
+    }
+
+    EPOLL_WRAPPER_DECL const char* Buffer::data() const
+    {
+        return mStorage.data();
+    }
+
+    EPOLL_WRAPPER_DECL std::size_t Buffer::size() const
+    {
+        return mStorage.size();
+    }
+
+    EPOLL_WRAPPER_DECL void Buffer::resize(std::size_t size)
+    {
+        mStorage.resize(size);
+    }
+
+    EPOLL_WRAPPER_DECL void Buffer::release()
+    {
+        if (mPool)
+        {
+            mPool->release(std::move(mStorage));
+            mPool = nullptr;
+        }
+    }
+
+    EPOLL_WRAPPER_DECL BufferPool::BufferPool(std::size_t maxFree) : mMaxFree(maxFree) {}
+
+    EPOLL_WRAPPER_DECL Buffer BufferPool::acquire(std::size_t size)
+    {
+        std::vector<char> storage;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mFree.empty())
+            {
+                storage = std::move(mFree.back());
+                mFree.pop_back();
+            }
+        }
+
+        // Reused storage keeps its capacity, so this only allocates while warming up
+        storage.resize(size);
+        return Buffer{this, std::move(storage)};
+    }
+
+    EPOLL_WRAPPER_DECL std::size_t BufferPool::available() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFree.size();
+    }
+
+    EPOLL_WRAPPER_DECL void BufferPool::release(std::vector<char>&& storage)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mFree.size() < mMaxFree)
+        {
+            mFree.emplace_back(std::move(storage));
+        }
+    }
+
+    EPOLL_WRAPPER_DECL std::unique_ptr<BlockingPool> BlockingPool::create(std::size_t threads, std::size_t maxQueued, std::size_t maxFreeBuffers)
+    {
+        int eventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (eventFd < 0)
+        {
+            return nullptr;
+        }
+
+        return std::unique_ptr<BlockingPool>(new BlockingPool(eventFd, threads, maxQueued, maxFreeBuffers));
+    }
+
+    EPOLL_WRAPPER_DECL BlockingPool::BlockingPool(int eventFd, std::size_t threads, std::size_t maxQueued, std::size_t maxFreeBuffers)
+        : mEventFd(eventFd), mMaxQueued(maxQueued), mBuffers(maxFreeBuffers)
+    {
+        for (std::size_t i = 0; i < threads; ++i)
+        {
+            mWorkers.emplace_back([this] { run(); });
+        }
+    }
+
+    EPOLL_WRAPPER_DECL BlockingPool::~BlockingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mJobsMutex);
+            mStopping = true;
+            mJobs.clear();
+        }
+
+        mJobsCv.notify_all();
+
+        for (auto& worker : mWorkers)
+        {
+            worker.join();
+        }
+
+        ::close(mEventFd);
+    }
+
+    EPOLL_WRAPPER_DECL bool BlockingPool::submitRead(uint64_t id, int fd, off_t offset, std::size_t size)
+    {
+        auto call = [this, fd, offset, size](Buffer& buffer) -> ssize_t {
+            buffer = mBuffers.acquire(size);
+            auto res = ::pread(fd, buffer.data(), size, offset);
+            buffer.resize(res < 0 ? 0 : res);
+            return res;
+        };
+
+        return push(Job{id, std::move(call), {}});
+    }
+
+    EPOLL_WRAPPER_DECL bool BlockingPool::submitWrite(uint64_t id, int fd, off_t offset, Buffer&& buffer)
+    {
+        auto call = [fd, offset](Buffer& buffer) -> ssize_t {
+            return ::pwrite(fd, buffer.data(), buffer.size(), offset);
+        };
+
+        return push(Job{id, std::move(call), std::move(buffer)});
+    }
+
+    EPOLL_WRAPPER_DECL bool BlockingPool::submit(uint64_t id, std::function<ssize_t()> call)
+    {
+        auto wrapped = [call = std::move(call)](Buffer&) -> ssize_t {
+            return call();
+        };
+
+        return push(Job{id, std::move(wrapped), {}});
+    }
+
+    EPOLL_WRAPPER_DECL std::vector<Completion> BlockingPool::drain()
+    {
+        // Reset the counter before taking the batch; a completion pushed after the
+        // swap writes the eventfd again, so none can be missed.
+        uint64_t count;
+        (void)::read(mEventFd, &count, sizeof(count));
+
+        std::vector<Completion> done;
+        {
+            std::lock_guard<std::mutex> lock(mDoneMutex);
+            done.swap(mDone);
+        }
+
+        return done;
+    }
+
+    EPOLL_WRAPPER_DECL BufferPool& BlockingPool::getBuffers()
+    {
+        return mBuffers;
+    }
+
+    EPOLL_WRAPPER_DECL int BlockingPool::getFileDescriptor() const
+    {
+        return mEventFd;
+    }
+
+    EPOLL_WRAPPER_DECL bool BlockingPool::push(Job&& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mJobsMutex);
+            if (mJobs.size() >= mMaxQueued)
+            {
+                return false;
+            }
+
+            mJobs.emplace_back(std::move(job));
+        }
+
+        mJobsCv.notify_one();
+        return true;
+    }
+
+    EPOLL_WRAPPER_DECL void BlockingPool::run()
+    {
+        while (true)
+        {
+            Job job;
+
+            {
+                std::unique_lock<std::mutex> lock(mJobsMutex);
+                mJobsCv.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+
+                if (mStopping)
+                {
+                    return;
+                }
+
+                job = std::move(mJobs.front());
+                mJobs.pop_front();
+            }
+
+            errno = 0;
+            auto res = job.mCall(job.mBuffer);
+            auto callErrno = res < 0 ? errno : 0;
+
+            bool wasEmpty;
+            {
+                std::lock_guard<std::mutex> lock(mDoneMutex);
+                wasEmpty = mDone.empty();
+                mDone.push_back(Completion{job.mId, res, fromEpollError(callErrno), callErrno, std::move(job.mBuffer)});
+            }
+
+            // One wakeup per batch: the loop drains everything queued so far
+            if (wasEmpty)
+            {
+                uint64_t one = 1;
+                (void)::write(mEventFd, &one, sizeof(one));
+            }
+        }
+    }
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "../EventBatch.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace epoll_wrapper
+{
+    namespace detail
+    {
+        inline constexpr uint32_t READABLE = EPOLLIN | EPOLLPRI;
+        inline constexpr uint32_t WRITABLE = EPOLLOUT;
+        inline constexpr uint32_t ERRORS = EPOLLERR | EPOLLHUP;
+
+        // Appends the indices of the set bits in a 4-lane movemask
+        EPOLL_WRAPPER_DECL uint32_t* pushLanes(uint32_t* out, int bits, uint32_t base)
+        {
+            while (bits)
+            {
+                *out++ = base + __builtin_ctz(bits);
+                bits &= bits - 1;
+            }
+
+            return out;
+        }
+    }
+
+    EPOLL_WRAPPER_DECL EventBatch::EventBatch(std::size_t capacity) : mRaw(capacity)
+    {
+        mFds.reserve(capacity);
+        mMasks.reserve(capacity);
+        mReadable.reserve(capacity);
+        mWritable.reserve(capacity);
+        mErrors.reserve(capacity);
+    }
+
+    EPOLL_WRAPPER_DECL std::size_t EventBatch::size() const
+    {
+        return mFds.size();
+    }
+
+    EPOLL_WRAPPER_DECL std::size_t EventBatch::capacity() const
+    {
+        return mRaw.size();
+    }
+
+    EPOLL_WRAPPER_DECL const std::vector<uint32_t>& EventBatch::getFds() const
+    {
+        return mFds;
+    }
+
+    EPOLL_WRAPPER_DECL const std::vector<uint32_t>& EventBatch::getMasks() const
+    {
+        return mMasks;
+    }
+
+    EPOLL_WRAPPER_DECL const std::vector<uint32_t>& EventBatch::getReadable() const
+    {
+        return mReadable;
+    }
+
+    EPOLL_WRAPPER_DECL const std::vector<uint32_t>& EventBatch::getWritable() const
+    {
+        return mWritable;
+    }
+
+    EPOLL_WRAPPER_DECL const std::vector<uint32_t>& EventBatch::getErrors() const
+    {
+        return mErrors;
+    }
+
+    EPOLL_WRAPPER_DECL struct epoll_event* EventBatch::getRaw()
+    {
+        return mRaw.data();
+    }
+
+    EPOLL_WRAPPER_DECL void EventBatch::assign(std::size_t count)
+    {
+        // Sized up front and trimmed afterwards so the loops write through raw
+        // pointers; capacity was reserved in the constructor.
+        mFds.resize(count);
+        mMasks.resize(count);
+        mReadable.resize(count);
+        mWritable.resize(count);
+        mErrors.resize(count);
+
+        auto* fds = mFds.data();
+        auto* masks = mMasks.data();
+        auto* readable = mReadable.data();
+        auto* writable = mWritable.data();
+        auto* errors = mErrors.data();
+
+        std::size_t i = 0;
+
+#if defined(__SSE2__) && defined(__x86_64__)
+        // x86-64 packs epoll_event into 12 bytes: u32 events, then u64 data
+        // whose low half is data.fd. Four events are three 16-byte loads.
+        static_assert(sizeof(struct epoll_event) == 12, "expected packed epoll_event");
+
+        const auto* raw = reinterpret_cast<const char*>(mRaw.data());
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i readMask = _mm_set1_epi32(detail::READABLE);
+        const __m128i writeMask = _mm_set1_epi32(detail::WRITABLE);
+        const __m128i errorMask = _mm_set1_epi32(detail::ERRORS);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            auto a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + i * 12)));
+            auto b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + i * 12 + 16)));
+            auto c = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + i * 12 + 32)));
+
+            // a = e0 f0 h0 e1, b = f1 h1 e2 f2, c = h2 e3 f3 h3
+            auto e01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 2, 3, 0));
+            auto e23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+            auto m = _mm_castps_si128(_mm_shuffle_ps(e01, e23, _MM_SHUFFLE(2, 0, 1, 0)));
+
+            auto f01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+            auto f23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+            auto f = _mm_castps_si128(_mm_shuffle_ps(f01, f23, _MM_SHUFFLE(2, 0, 2, 0)));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(masks + i), m);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(fds + i), f);
+
+            auto noRead = _mm_cmpeq_epi32(_mm_and_si128(m, readMask), zero);
+            auto noWrite = _mm_cmpeq_epi32(_mm_and_si128(m, writeMask), zero);
+            auto noError = _mm_cmpeq_epi32(_mm_and_si128(m, errorMask), zero);
+
+            readable = detail::pushLanes(readable, ~_mm_movemask_ps(_mm_castsi128_ps(noRead)) & 0xf, i);
+            writable = detail::pushLanes(writable, ~_mm_movemask_ps(_mm_castsi128_ps(noWrite)) & 0xf, i);
+            errors = detail::pushLanes(errors, ~_mm_movemask_ps(_mm_castsi128_ps(noError)) & 0xf, i);
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            auto mask = mRaw[i].events;
+
+            fds[i] = static_cast<uint32_t>(mRaw[i].data.fd);
+            masks[i] = mask;
+
+            if (mask & detail::READABLE) { *readable++ = i; }
+            if (mask & detail::WRITABLE) { *writable++ = i; }
+            if (mask & detail::ERRORS)   { *errors++ = i;   }
+        }
+
+        mReadable.resize(readable - mReadable.data());
+        mWritable.resize(writable - mWritable.data());
+        mErrors.resize(errors - mErrors.data());
+    }
+
+    EPOLL_WRAPPER_DECL void EventBatch::compact()
+    {
+        mReadable.clear();
+        mWritable.clear();
+        mErrors.clear();
+
+        std::size_t out = 0;
+
+        for (std::size_t i = 0; i < mMasks.size(); ++i)
+        {
+            auto mask = mMasks[i];
+
+            if (mask == 0)
+            {
+                continue;
+            }
+
+            mFds[out] = mFds[i];
+            mMasks[out] = mask;
+
+            if (mask & detail::READABLE) { mReadable.push_back(out); }
+            if (mask & detail::WRITABLE) { mWritable.push_back(out); }
+            if (mask & detail::ERRORS)   { mErrors.push_back(out);   }
+
+            ++out;
+        }
+
+        mFds.resize(out);
+        mMasks.resize(out);
+    }
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "../Handoff.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace epoll_wrapper
+{
+    namespace detail
+    {
+        struct WireEntry
+        {
+            uint64_t mTag;
+            uint32_t mEvents;
+            uint32_t mReserved;
+        };
+
+        EPOLL_WRAPPER_DECL ErrorCode sendBatch(int socket, const void* data, std::size_t size, const int* fds, std::size_t count)
+        {
+            struct iovec iov;
+            iov.iov_base = const_cast<void*>(data);
+            iov.iov_len = size;
+
+            alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOFF_BATCH)];
+
+            struct msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+
+            if (count > 0)
+            {
+                msg.msg_control = control;
+                msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+                auto* cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+                std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+            }
+
+            while (::sendmsg(socket, &msg, MSG_NOSIGNAL) < 0)
+            {
+                if (errno != EINTR)
+                {
+                    return fromEpollError(errno);
+                }
+            }
+
+            return ErrorCode::None;
+        }
+
+        // Returns the payload size through size and appends any passed fds
+        EPOLL_WRAPPER_DECL ErrorCode receiveBatch(int socket, void* data, std::size_t& size, std::vector<int>& fds)
+        {
+            struct iovec iov;
+            iov.iov_base = data;
+            iov.iov_len = size;
+
+            alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOFF_BATCH)];
+
+            struct msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            ssize_t received;
+            while ((received = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC)) < 0)
+            {
+                if (errno != EINTR)
+                {
+                    return fromEpollError(errno);
+                }
+            }
+
+            for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                {
+                    auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    auto first = fds.size();
+                    fds.resize(first + count);
+                    std::memcpy(fds.data() + first, CMSG_DATA(cmsg), sizeof(int) * count);
+                }
+            }
+
+            if (received == 0 || msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+            {
+                return ErrorCode::Einval;
+            }
+
+            size = received;
+            return ErrorCode::None;
+        }
+    }
+
+    EPOLL_WRAPPER_DECL ErrorCode sendRegistrations(int socket, const std::vector<Registration>& registrations)
+    {
+        uint64_t total = registrations.size();
+
+        if (auto err = detail::sendBatch(socket, &total, sizeof(total), nullptr, 0); err != ErrorCode::None)
+        {
+            return err;
+        }
+
+        detail::WireEntry entries[HANDOFF_BATCH];
+        int fds[HANDOFF_BATCH];
+
+        for (std::size_t first = 0; first < registrations.size(); first += HANDOFF_BATCH)
+        {
+            auto count = std::min(HANDOFF_BATCH, registrations.size() - first);
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto& reg = registrations[first + i];
+                entries[i] = detail::WireEntry{reg.mTag, reg.mEvents, 0};
+                fds[i] = reg.mFd;
+            }
+
+            if (auto err = detail::sendBatch(socket, entries, sizeof(detail::WireEntry) * count, fds, count); err != ErrorCode::None)
+            {
+                return err;
+            }
+        }
+
+        return ErrorCode::None;
+    }
+
+    EPOLL_WRAPPER_DECL ErrorCode receiveRegistrations(int socket, std::vector<Registration>& registrations)
+    {
+        std::vector<int> fds;
+
+        uint64_t total;
+        std::size_t size = sizeof(total);
+
+        if (auto err = detail::receiveBatch(socket, &total, size, fds); err != ErrorCode::None)
+        {
+            return err;
+        }
+
+        if (size != sizeof(total) || !fds.empty())
+        {
+            for (auto fd : fds)
+            {
+                ::close(fd);
+            }
+
+            return ErrorCode::Einval;
+        }
+
+        // total comes from the peer, so don't reserve on its word; batches
+        // are bounded by HANDOFF_BATCH and push_back grows as they arrive
+        auto original = registrations.size();
+
+        detail::WireEntry entries[HANDOFF_BATCH];
+        auto err = ErrorCode::None;
+
+        while (total > 0)
+        {
+            fds.clear();
+            size = sizeof(entries);
+
+            err = detail::receiveBatch(socket, entries, size, fds);
+
+            auto count = size / sizeof(detail::WireEntry);
+            if (err == ErrorCode::None && (size % sizeof(detail::WireEntry) != 0 || count != fds.size() || count > total))
+            {
+                err = ErrorCode::Einval;
+            }
+
+            if (err != ErrorCode::None)
+            {
+                // Don't leak whatever arrived with a bad batch, and undo the
+                // batches taken before it so the caller is left as it was
+                for (auto fd : fds)
+                {
+                    ::close(fd);
+                }
+
+                for (auto i = original; i < registrations.size(); ++i)
+                {
+                    ::close(registrations[i].mFd);
+                }
+
+                registrations.resize(original);
+                return err;
+            }
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                registrations.push_back(Registration{fds[i], static_cast<EventCodeMask>(entries[i].mEvents), entries[i].mTag, 0});
+            }
+
+            total -= count;
+        }
+
+        return ErrorCode::None;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../Light.h"
+
+#include <memory>
+#include <optional>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace epoll_wrapper
+{
+    EPOLL_WRAPPER_DECL Light::Light(int epollFd) : mEpollFd(epollFd) {}
+
+    EPOLL_WRAPPER_DECL Light::~Light()
+    {
+        close();
+    }
+
+    EPOLL_WRAPPER_DECL std::unique_ptr<Light> Light::epoll_create(int size)
+    {
+        int epollFd = ::epoll_create1(0);
+
+        return std::unique_ptr<Light>(new Light(epollFd));
+    }
+
+    EPOLL_WRAPPER_DECL int Light::epoll_ctl(int op, int fd, struct epoll_event *event)
+    {
+        return ::epoll_ctl(mEpollFd, op, fd, event);
+    }
+
+    EPOLL_WRAPPER_DECL int Light::epoll_wait(struct epoll_event *events, int maxevents, int timeout)
+    {
+        return ::epoll_wait(mEpollFd, events, maxevents, timeout);
+    }
+
+    EPOLL_WRAPPER_DECL void Light::close()
+    {
+        // Also runs from the destructor, so never close a reused fd number twice
+        if (mEpollFd >= 0)
+        {
+            ::close(mEpollFd);
+            mEpollFd = -1;
+        }
+    }
+
+    EPOLL_WRAPPER_DECL int Light::getUnderlying() const
+    {
+        return mEpollFd;
+    }
+}
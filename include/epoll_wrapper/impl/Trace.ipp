@@ -0,0 +1,271 @@
+#pragma once
+
+#include "../Trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+
+namespace epoll_wrapper
+{
+    namespace detail
+    {
+        template <typename T>
+        void writeValue(std::ofstream& out, T value)
+        {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        template <typename T>
+        bool readValue(const std::vector<char>& in, std::size_t& pos, T& value)
+        {
+            if (in.size() - pos < sizeof(value))
+            {
+                return false;
+            }
+
+            std::copy_n(in.data() + pos, sizeof(value), reinterpret_cast<char*>(&value));
+            pos += sizeof(value);
+            return true;
+        }
+    }
+
+    EPOLL_WRAPPER_DECL Recorder::Recorder(std::unique_ptr<Light> light, std::ofstream&& trace)
+        : mLight(std::move(light)), mTrace(std::move(trace)), mStart(std::chrono::steady_clock::now()) {}
+
+    EPOLL_WRAPPER_DECL std::unique_ptr<Recorder> Recorder::open(const std::string& path)
+    {
+        std::ofstream trace(path, std::ios::binary | std::ios::trunc);
+
+        if (!trace)
+        {
+            return nullptr;
+        }
+
+        auto light = Light::epoll_create(1);
+
+        if (!light || light->getUnderlying() < 0)
+        {
+            return nullptr;
+        }
+
+        detail::writeValue(trace, TRACE_MAGIC);
+        detail::writeValue(trace, TRACE_VERSION);
+
+        return std::unique_ptr<Recorder>(new Recorder(std::move(light), std::move(trace)));
+    }
+
+    EPOLL_WRAPPER_DECL void Recorder::writeHeader(TraceRecord kind)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - mStart;
+
+        detail::writeValue(mTrace, static_cast<uint8_t>(kind));
+        detail::writeValue(mTrace, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    EPOLL_WRAPPER_DECL int Recorder::epoll_ctl(int op, int fd, struct epoll_event *event)
+    {
+        auto res = mLight->epoll_ctl(op, fd, event);
+        auto err = errno;
+
+        writeHeader(TraceRecord::Ctl);
+        detail::writeValue(mTrace, static_cast<int32_t>(op));
+        detail::writeValue(mTrace, static_cast<int32_t>(fd));
+        detail::writeValue(mTrace, static_cast<uint32_t>(event ? event->events : 0));
+        detail::writeValue(mTrace, static_cast<int32_t>(res));
+        detail::writeValue(mTrace, static_cast<int32_t>(res < 0 ? err : 0));
+
+        errno = err;
+        return res;
+    }
+
+    EPOLL_WRAPPER_DECL int Recorder::epoll_wait(struct epoll_event *events, int maxevents, int timeout)
+    {
+        auto res = mLight->epoll_wait(events, maxevents, timeout);
+        auto err = errno;
+
+        writeHeader(TraceRecord::Wait);
+        detail::writeValue(mTrace, static_cast<int32_t>(timeout));
+        detail::writeValue(mTrace, static_cast<int32_t>(res));
+        detail::writeValue(mTrace, static_cast<int32_t>(res < 0 ? err : 0));
+
+        if (res > 0)
+        {
+            mTrace.write(reinterpret_cast<const char*>(events), res * sizeof(struct epoll_event));
+        }
+
+        errno = err;
+        return res;
+    }
+
+    EPOLL_WRAPPER_DECL void Recorder::close()
+    {
+        mLight->close();
+        mTrace.close();
+    }
+
+    EPOLL_WRAPPER_DECL void Recorder::flush()
+    {
+        mTrace.flush();
+    }
+
+    EPOLL_WRAPPER_DECL int Recorder::getUnderlying() const
+    {
+        return mLight->getUnderlying();
+    }
+
+    EPOLL_WRAPPER_DECL std::unique_ptr<Replay> Replay::open(const std::string& path)
+    {
+        std::ifstream trace(path, std::ios::binary);
+
+        if (!trace)
+        {
+            return nullptr;
+        }
+
+        std::vector<char> in{std::istreambuf_iterator<char>(trace), std::istreambuf_iterator<char>()};
+        std::size_t pos = 0;
+
+        uint32_t magic, version;
+        if (!detail::readValue(in, pos, magic) || !detail::readValue(in, pos, version) || magic != TRACE_MAGIC || version != TRACE_VERSION)
+        {
+            errno = EINVAL;
+            return nullptr;
+        }
+
+        auto replay = std::unique_ptr<Replay>(new Replay());
+
+        while (pos < in.size())
+        {
+            uint8_t kind;
+            uint64_t timestamp;
+
+            if (!detail::readValue(in, pos, kind) || !detail::readValue(in, pos, timestamp))
+            {
+                errno = EINVAL;
+                return nullptr;
+            }
+
+            if (kind == static_cast<uint8_t>(TraceRecord::Ctl))
+            {
+                CtlRecord ctl;
+                uint32_t events;
+
+                if (!detail::readValue(in, pos, ctl.mOp) || !detail::readValue(in, pos, ctl.mFd) || !detail::readValue(in, pos, events)
+                    || !detail::readValue(in, pos, ctl.mResult) || !detail::readValue(in, pos, ctl.mErrno))
+                {
+                    errno = EINVAL;
+                    return nullptr;
+                }
+
+                replay->mCtls.push_back(ctl);
+            }
+            else if (kind == static_cast<uint8_t>(TraceRecord::Wait))
+            {
+                WaitRecord wait{0, 0, replay->mEvents.size()};
+                int32_t timeout;
+
+                if (!detail::readValue(in, pos, timeout) || !detail::readValue(in, pos, wait.mResult) || !detail::readValue(in, pos, wait.mErrno))
+                {
+                    errno = EINVAL;
+                    return nullptr;
+                }
+
+                for (int32_t i = 0; i < wait.mResult; ++i)
+                {
+                    struct epoll_event event;
+
+                    if (!detail::readValue(in, pos, event))
+                    {
+                        errno = EINVAL;
+                        return nullptr;
+                    }
+
+                    replay->mEvents.push_back(event);
+                }
+
+                replay->mWaits.push_back(wait);
+            }
+            else
+            {
+                errno = EINVAL;
+                return nullptr;
+            }
+        }
+
+        return replay;
+    }
+
+    EPOLL_WRAPPER_DECL int Replay::epoll_ctl(int op, int fd, struct epoll_event *)
+    {
+        // Look a little ahead so a call the application no longer makes doesn't
+        // throw every later call out of step
+        auto end = std::min(mCtls.size(), mCtlPos + RESYNC_WINDOW);
+
+        for (auto pos = mCtlPos; pos < end; ++pos)
+        {
+            if (mCtls[pos].mOp == op && mCtls[pos].mFd == fd)
+            {
+                mDivergences += pos - mCtlPos;
+                mCtlPos = pos + 1;
+
+                errno = mCtls[pos].mErrno;
+                return mCtls[pos].mResult;
+            }
+        }
+
+        ++mDivergences;
+        return 0;
+    }
+
+    EPOLL_WRAPPER_DECL int Replay::epoll_wait(struct epoll_event *events, int maxevents, int)
+    {
+        if (mWaitPos >= mWaits.size())
+        {
+            return 0;
+        }
+
+        const auto& wait = mWaits[mWaitPos];
+
+        if (wait.mResult <= 0)
+        {
+            ++mWaitPos;
+            errno = wait.mErrno;
+            return wait.mResult;
+        }
+
+        // A batch larger than the caller's buffer is handed out over several waits
+        auto remaining = static_cast<std::size_t>(wait.mResult) - mEventPos;
+        auto count = std::min(remaining, static_cast<std::size_t>(maxevents));
+
+        std::copy_n(mEvents.begin() + wait.mFirst + mEventPos, count, events);
+        mEventPos += count;
+
+        if (mEventPos == static_cast<std::size_t>(wait.mResult))
+        {
+            ++mWaitPos;
+            mEventPos = 0;
+        }
+
+        return static_cast<int>(count);
+    }
+
+    EPOLL_WRAPPER_DECL void Replay::close()
+    {
+    }
+
+    EPOLL_WRAPPER_DECL int Replay::getUnderlying() const
+    {
+        return -1;
+    }
+
+    EPOLL_WRAPPER_DECL bool Replay::finished() const
+    {
+        return mWaitPos >= mWaits.size() && mCtlPos >= mCtls.size();
+    }
+
+    EPOLL_WRAPPER_DECL std::size_t Replay::getDivergences() const
+    {
+        return mDivergences;
+    }
+}
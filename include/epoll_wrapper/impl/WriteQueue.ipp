@@ -0,0 +1,236 @@
+#pragma once
+
+#include "../WriteQueue.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace epoll_wrapper
+{
+    EPOLL_WRAPPER_DECL SendAction::SendAction(ErrorCode errc, bool backpressure)
+        : mErrc(errc), mBackpressure(backpressure) {}
+
+    EPOLL_WRAPPER_DECL bool SendAction::hasError() const
+    {
+        return mErrc != ErrorCode::None;
+    }
+
+    EPOLL_WRAPPER_DECL ErrorCode SendAction::getError() const
+    {
+        return mErrc;
+    }
+
+    EPOLL_WRAPPER_DECL bool SendAction::hasBackpressure() const
+    {
+        return mBackpressure;
+    }
+
+    EPOLL_WRAPPER_DECL WriteQueue::WriteQueue(std::size_t lowWatermark, std::size_t highWatermark)
+        : mLowWatermark(lowWatermark), mHighWatermark(highWatermark) {}
+
+    EPOLL_WRAPPER_DECL void WriteQueue::setWatermarks(std::size_t lowWatermark, std::size_t highWatermark)
+    {
+        mLowWatermark = lowWatermark;
+        mHighWatermark = highWatermark;
+        updatePaused();
+    }
+
+    EPOLL_WRAPPER_DECL ErrorCode WriteQueue::send(int fd, const char* data, std::size_t size)
+    {
+        if (empty())
+        {
+            while (size > 0)
+            {
+                auto written = writeOnce(fd, data, size);
+
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        break;
+                    }
+
+                    return fromEpollError(errno);
+                }
+
+                data += written;
+                size -= written;
+            }
+        }
+
+        append(data, size);
+        updatePaused();
+
+        return ErrorCode::None;
+    }
+
+    EPOLL_WRAPPER_DECL ErrorCode WriteQueue::flush(int fd)
+    {
+        struct iovec iov[IOV_MAX];
+
+        while (!empty())
+        {
+            int count = 0;
+            std::size_t requested = 0;
+
+            for (auto it = mChunks.begin(); it != mChunks.end() && count < IOV_MAX; ++it, ++count)
+            {
+                auto offset = count == 0 ? mOffset : 0;
+                iov[count].iov_base = it->data() + offset;
+                iov[count].iov_len = it->size() - offset;
+                requested += iov[count].iov_len;
+            }
+
+            auto written = writeVector(fd, iov, count);
+
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    break;
+                }
+
+                return fromEpollError(errno);
+            }
+
+            consume(written);
+
+            if (static_cast<std::size_t>(written) < requested)
+            {
+                break;
+            }
+        }
+
+        updatePaused();
+
+        return ErrorCode::None;
+    }
+
+    EPOLL_WRAPPER_DECL void WriteQueue::clear()
+    {
+        mChunks.clear();
+        mOffset = 0;
+        mSize = 0;
+        mPaused = false;
+    }
+
+    EPOLL_WRAPPER_DECL std::size_t WriteQueue::size() const
+    {
+        return mSize;
+    }
+
+    EPOLL_WRAPPER_DECL bool WriteQueue::empty() const
+    {
+        return mSize == 0;
+    }
+
+    EPOLL_WRAPPER_DECL bool WriteQueue::isPaused() const
+    {
+        return mPaused;
+    }
+
+    EPOLL_WRAPPER_DECL ssize_t WriteQueue::writeOnce(int fd, const char* data, std::size_t size)
+    {
+        if (mSocket)
+        {
+            auto written = ::send(fd, data, size, MSG_NOSIGNAL);
+
+            if (written >= 0 || errno != ENOTSOCK)
+            {
+                return written;
+            }
+
+            mSocket = false;
+        }
+
+        return ::write(fd, data, size);
+    }
+
+    EPOLL_WRAPPER_DECL ssize_t WriteQueue::writeVector(int fd, struct iovec* iov, int count)
+    {
+        if (mSocket)
+        {
+            struct msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+
+            auto written = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+
+            if (written >= 0 || errno != ENOTSOCK)
+            {
+                return written;
+            }
+
+            mSocket = false;
+        }
+
+        return ::writev(fd, iov, count);
+    }
+
+    EPOLL_WRAPPER_DECL void WriteQueue::append(const char* data, std::size_t size)
+    {
+        mSize += size;
+
+        while (size > 0)
+        {
+            if (mChunks.empty() || mChunks.back().size() >= CHUNK_SIZE)
+            {
+                mChunks.emplace_back();
+                mChunks.back().reserve(CHUNK_SIZE);
+            }
+
+            auto& chunk = mChunks.back();
+            auto n = std::min(size, CHUNK_SIZE - chunk.size());
+            chunk.insert(chunk.end(), data, data + n);
+
+            data += n;
+            size -= n;
+        }
+    }
+
+    EPOLL_WRAPPER_DECL void WriteQueue::consume(std::size_t size)
+    {
+        mSize -= size;
+
+        while (size > 0)
+        {
+            auto remaining = mChunks.front().size() - mOffset;
+
+            if (size < remaining)
+            {
+                mOffset += size;
+                return;
+            }
+
+            size -= remaining;
+            mChunks.pop_front();
+            mOffset = 0;
+        }
+    }
+
+    EPOLL_WRAPPER_DECL void WriteQueue::updatePaused()
+    {
+        if (mSize > mHighWatermark)
+        {
+            mPaused = true;
+        }
+        else if (mSize <= mLowWatermark)
+        {
+            mPaused = false;
+        }
+    }
+}
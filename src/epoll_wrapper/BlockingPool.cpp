@@ -0,0 +1 @@
+#include "epoll_wrapper/impl/BlockingPool.ipp"
@@ -0,0 +1,7 @@
+#include "epoll_wrapper/Epoll.h"
+
+namespace epoll_wrapper
+{
+    template class WaitAction<int>;
+    template class EpollImpl<Light, int>;
+}
@@ -0,0 +1 @@
+#include "epoll_wrapper/impl/EventBatch.ipp"
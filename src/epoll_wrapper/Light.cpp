@@ -1,43 +1 @@
-#include "epoll_wrapper/Light.h"
-
-#include <memory>
-#include <optional>
-#include <sys/epoll.h>
-#include <unistd.h>
-
-namespace epoll_wrapper
-{
-    Light::Light(int epollFd) : mEpollFd(epollFd) {}
-
-    Light::~Light()
-    {
-        close();
-    }
-
-    std::unique_ptr<Light> Light::epoll_create(int size)
-    {
-        int epollFd = ::epoll_create1(0);
-
-        return std::unique_ptr<Light>(new Light(epollFd));
-    }
-
-    int Light::epoll_ctl(int op, int fd, struct epoll_event *event)
-    {
-        return ::epoll_ctl(mEpollFd, op, fd, event);
-    }
-
-    int Light::epoll_wait(struct epoll_event *events, int maxevents, int timeout)
-    {
-        return ::epoll_wait(mEpollFd, events, maxevents, timeout);
-    }
-
-    void Light::close()
-    {
-        ::close(mEpollFd);
-    }
-
-    int Light::getUnderlying() const
-    {
-        return mEpollFd;
-    }
-}
\ No newline at end of file
+#include "epoll_wrapper/impl/Light.ipp"
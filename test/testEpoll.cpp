@@ -1,17 +1,30 @@
+#include "epoll_wrapper/BlockingPool.h"
 #include "epoll_wrapper/Epoll.h"
 #include "epoll_wrapper/Light.h"
-#include "epoll_wrapper/EpollImpl.ipp"
+#include "epoll_wrapper/Trace.h"
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <future>
 #include <memory>
 #include <optional>
 #include <sstream>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
 
 using namespace epoll_wrapper;
+using namespace std::chrono_literals;
 
 struct MockEpoll
 {
@@ -249,3 +262,1013 @@ TEST(EPOLL, mod_update_events)
 
 }
 
+TEST(EPOLL, idle_timeout_expires)
+{
+    auto createEpoll = EpollImpl<Light, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    int mypipe[2];
+    ASSERT_EQ(pipe(mypipe), 0);
+
+    auto readFd = Fd{mypipe[0]};
+    ASSERT_FALSE(epoll.add(readFd, EventCode::EpollIn).hasError());
+    ASSERT_FALSE(epoll.setIdleTimeout(readFd, 20ms).hasError());
+
+    // An infinite wait must be cut short by the idle deadline
+    auto waitResult = epoll.wait();
+
+    ASSERT_FALSE(waitResult.hasError());
+    ASSERT_EQ(waitResult.getEvents().size(), 0);
+    ASSERT_EQ(waitResult.getExpired().size(), 1);
+    ASSERT_EQ(waitResult.getExpired().front().get().getFileDescriptor(), readFd.getFileDescriptor());
+
+    // Expired entries are reported once and then disarmed
+    auto waitResult2 = epoll.wait(0);
+    ASSERT_EQ(waitResult2.getExpired().size(), 0);
+    ASSERT_TRUE(epoll.hasFd(readFd.getFileDescriptor()));
+
+    ASSERT_TRUE(epoll.clearIdleTimeout(readFd).getError() == ErrorCode::EnoEnt);
+}
+
+TEST(EPOLL, idle_timeout_refreshed_by_activity)
+{
+    auto createEpoll = EpollImpl<Light, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    int mypipe[2];
+    ASSERT_EQ(pipe(mypipe), 0);
+
+    auto readFd = Fd{mypipe[0]};
+    ASSERT_FALSE(epoll.add(readFd, EventCode::EpollIn).hasError());
+    ASSERT_FALSE(epoll.setIdleTimeout(readFd, 200ms).hasError());
+
+    std::this_thread::sleep_for(120ms);
+
+    std::string input("test");
+    write_to_pipe(mypipe[1], input);
+
+    auto waitResult = epoll.wait(0);
+    ASSERT_EQ(waitResult.getEvents().size(), 1);
+    ASSERT_EQ(waitResult.getExpired().size(), 0);
+
+    char read_buf[READSIZE];
+    ASSERT_EQ(read(mypipe[0], read_buf, READSIZE), input.size());
+
+    // Past the original deadline, but within the refreshed one
+    std::this_thread::sleep_for(120ms);
+
+    auto waitResult2 = epoll.wait(0);
+    ASSERT_EQ(waitResult2.getEvents().size(), 0);
+    ASSERT_EQ(waitResult2.getExpired().size(), 0);
+}
+
+TEST(EPOLL, idle_timeout_shrinks_wait)
+{
+    auto createEpoll = EpollImpl<MockEpoll, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    auto fd1 = Fd{0};
+    auto fd2 = Fd{1};
+
+    auto &underlying = epoll.getUnderlying();
+    EXPECT_CALL(underlying, epoll_ctl).Times(3);
+
+    ASSERT_TRUE(epoll.setIdleTimeout(fd1, 1000ms).getError() == ErrorCode::EnoEnt);
+
+    epoll.add(fd1, EventCode::EpollIn);
+    epoll.add(fd2, EventCode::EpollIn);
+    ASSERT_TRUE(epoll.setIdleTimeout(fd1, 0ms).getError() == ErrorCode::Einval);
+    ASSERT_FALSE(epoll.setIdleTimeout(fd1, 60000ms).hasError());
+    ASSERT_FALSE(epoll.setIdleTimeout(fd2, 1000ms).hasError());
+
+    EXPECT_CALL(underlying, epoll_wait(testing::_, testing::_, testing::AllOf(testing::Gt(0), testing::Le(1000))))
+        .WillOnce(testing::Return(0));
+    EXPECT_CALL(underlying, epoll_wait(testing::_, testing::_, 5))
+        .WillOnce(testing::Return(0));
+
+    ASSERT_EQ(epoll.wait().getExpired().size(), 0);
+    ASSERT_EQ(epoll.wait(5).getExpired().size(), 0);
+
+    // Erasing a registration drops its deadline with it
+    epoll.erase(fd2);
+    ASSERT_TRUE(epoll.clearIdleTimeout(fd2).getError() == ErrorCode::EnoEnt);
+    ASSERT_FALSE(epoll.clearIdleTimeout(fd1).hasError());
+}
+
+TEST(EPOLL, idle_timeout_rearmed_and_long)
+{
+    auto createEpoll = EpollImpl<MockEpoll, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+    auto &underlying = epoll.getUnderlying();
+
+    auto fd = Fd{0};
+
+    EXPECT_CALL(underlying, epoll_ctl).Times(1);
+    epoll.add(fd, EventCode::EpollIn);
+
+    // Only the latest timeout counts, however many were used before
+    for (int i = 1; i <= 1000; ++i)
+    {
+        ASSERT_FALSE(epoll.setIdleTimeout(fd, std::chrono::milliseconds(i)).hasError());
+    }
+
+    // A deadline past INT32_MAX ms must not wrap into a negative timeout
+    ASSERT_FALSE(epoll.setIdleTimeout(fd, std::chrono::hours(24 * 30)).hasError());
+
+    EXPECT_CALL(underlying, epoll_wait(testing::_, testing::_, std::numeric_limits<int32_t>::max()))
+        .WillOnce(testing::Return(0));
+
+    ASSERT_EQ(epoll.wait().getExpired().size(), 0);
+}
+
+void set_nonblocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+TEST(EPOLL, send_writes_directly)
+{
+    auto createEpoll = EpollImpl<Light, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    int mypipe[2];
+    ASSERT_EQ(pipe(mypipe), 0);
+    set_nonblocking(mypipe[1]);
+
+    auto writeFd = Fd{mypipe[1]};
+    ASSERT_TRUE(epoll.send(writeFd, "x", 1).getError() == ErrorCode::EnoEnt);
+    ASSERT_FALSE(epoll.add(writeFd, EventCode::EpollErr).hasError());
+
+    std::string input("test");
+    auto res = epoll.send(writeFd, input.c_str(), input.size());
+
+    ASSERT_FALSE(res.hasError());
+    ASSERT_FALSE(res.hasBackpressure());
+    ASSERT_EQ(epoll.getQueued(writeFd), 0);
+    ASSERT_EQ(epoll.getEvents(writeFd), EventCode::None | EventCode::EpollErr);
+
+    char read_buf[READSIZE];
+    ASSERT_EQ(read(mypipe[0], read_buf, READSIZE), input.size());
+    ASSERT_EQ(std::string(read_buf, input.size()), input);
+}
+
+TEST(EPOLL, send_backpressure)
+{
+    auto createEpoll = EpollImpl<Light, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    int mypipe[2];
+    ASSERT_EQ(pipe(mypipe), 0);
+    set_nonblocking(mypipe[0]);
+    set_nonblocking(mypipe[1]);
+
+    auto writeFd = Fd{mypipe[1]};
+    ASSERT_FALSE(epoll.add(writeFd, EventCode::EpollErr).hasError());
+    ASSERT_TRUE(epoll.setWatermarks(writeFd, 64 * 1024, 16 * 1024).getError() == ErrorCode::Einval);
+    ASSERT_FALSE(epoll.setWatermarks(writeFd, 16 * 1024, 64 * 1024).hasError());
+
+    std::string input;
+    for (int i = 0; i < 256 * 1024; ++i)
+    {
+        input.push_back(static_cast<char>('a' + i % 26));
+    }
+
+    // Many small writes, so most of them end up coalesced in the queue
+    bool backpressure = false;
+    for (std::size_t off = 0; off < input.size(); off += 100)
+    {
+        auto n = std::min<std::size_t>(100, input.size() - off);
+        auto res = epoll.send(writeFd, input.c_str() + off, n);
+        ASSERT_FALSE(res.hasError());
+        backpressure = res.hasBackpressure();
+    }
+
+    ASSERT_TRUE(backpressure);
+    ASSERT_GT(epoll.getQueued(writeFd), 64 * 1024);
+
+    std::string output;
+    bool resumed = false;
+    char read_buf[READSIZE];
+
+    while (output.size() < input.size())
+    {
+        auto n = read(mypipe[0], read_buf, READSIZE);
+        if (n > 0)
+        {
+            output.append(read_buf, n);
+        }
+
+        auto waitResult = epoll.wait(100);
+        ASSERT_FALSE(waitResult.hasError());
+
+        // Write interest was added by the queue, so it is never reported
+        ASSERT_EQ(waitResult.getEvents().size(), 0);
+
+        if (waitResult.getWritable().size() == 1)
+        {
+            ASSERT_FALSE(resumed);
+            ASSERT_LE(epoll.getQueued(writeFd), 16 * 1024);
+            resumed = true;
+        }
+    }
+
+    ASSERT_TRUE(resumed);
+    ASSERT_EQ(epoll.getQueued(writeFd), 0);
+    ASSERT_EQ(output, input);
+}
+
+TEST(EPOLL, send_to_closed_peer)
+{
+    auto createEpoll = EpollImpl<Light, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    set_nonblocking(sockets[0]);
+    close(sockets[1]);
+
+    auto sockFd = Fd{sockets[0]};
+    ASSERT_FALSE(epoll.add(sockFd, EventCode::EpollIn).hasError());
+
+    // Must surface as an error rather than killing the process with SIGPIPE
+    std::string input("test");
+    auto res = epoll.send(sockFd, input.c_str(), input.size());
+
+    ASSERT_TRUE(res.getError() == ErrorCode::Epipe);
+    ASSERT_EQ(epoll.getQueued(sockFd), 0);
+
+    close(sockets[0]);
+}
+
+TEST(EPOLL, send_toggles_write_interest)
+{
+    auto createEpoll = EpollImpl<MockEpoll, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    int mypipe[2];
+    ASSERT_EQ(pipe(mypipe), 0);
+    set_nonblocking(mypipe[0]);
+    set_nonblocking(mypipe[1]);
+
+    auto writeFd = Fd{mypipe[1]};
+    auto &underlying = epoll.getUnderlying();
+
+    auto hasOut = [](struct epoll_event *ev) { return (ev->events & EPOLLOUT) != 0; };
+    auto noOut = [](struct epoll_event *ev) { return (ev->events & EPOLLOUT) == 0; };
+
+    testing::InSequence seq;
+    EXPECT_CALL(underlying, epoll_ctl(EPOLL_CTL_ADD, mypipe[1], testing::Truly(noOut)));
+    EXPECT_CALL(underlying, epoll_ctl(EPOLL_CTL_MOD, mypipe[1], testing::Truly(hasOut)));
+    EXPECT_CALL(underlying, epoll_wait).WillOnce([&](struct epoll_event *events, int, int) {
+        events[0].events = EPOLLOUT;
+        events[0].data.fd = mypipe[1];
+        return 1;
+    });
+    EXPECT_CALL(underlying, epoll_ctl(EPOLL_CTL_MOD, mypipe[1], testing::Truly(noOut)));
+
+    epoll.add(writeFd, EventCode::EpollIn);
+
+    std::string chunk(32 * 1024, 'x');
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_FALSE(epoll.send(writeFd, chunk.c_str(), chunk.size()).hasError());
+    }
+
+    ASSERT_GT(epoll.getQueued(writeFd), 0);
+
+    char read_buf[READSIZE];
+    std::size_t total = 0;
+    while (total < 4 * chunk.size())
+    {
+        auto n = read(mypipe[0], read_buf, READSIZE);
+        ASSERT_GT(n, 0);
+        total += n;
+
+        if (total == 64 * 1024)
+        {
+            auto waitResult = epoll.wait(0);
+            ASSERT_EQ(waitResult.getEvents().size(), 0);
+            ASSERT_EQ(epoll.getQueued(writeFd), 0);
+        }
+    }
+}
+
+int make_temp_file(std::string contents)
+{
+    char path[] = "/tmp/testEpollXXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    write(fd, contents.c_str(), contents.size());
+    return fd;
+}
+
+TEST(EPOLL, regular_file_not_pollable)
+{
+    auto createEpoll = EpollImpl<Light, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    auto fileFd = Fd{make_temp_file("test")};
+    ASSERT_TRUE(epoll.add(fileFd, EventCode::EpollIn).getError() == ErrorCode::Eperm);
+
+    close(fileFd.getFileDescriptor());
+}
+
+TEST(EPOLL, blocking_pool_read_write)
+{
+    auto createEpoll = EpollImpl<Light, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    auto pool = BlockingPool::create(2, 16);
+    ASSERT_TRUE(pool);
+
+    auto poolFd = Fd{pool->getFileDescriptor()};
+    ASSERT_FALSE(epoll.add(poolFd, EventCode::EpollIn).hasError());
+
+    std::string input("offloaded read");
+    int fileFd = make_temp_file(input);
+
+    ASSERT_TRUE(pool->submitRead(1, fileFd, 0, 64));
+
+    std::vector<Completion> completions;
+    while (completions.empty())
+    {
+        auto waitResult = epoll.wait(1000);
+        ASSERT_FALSE(waitResult.hasError());
+        ASSERT_EQ(waitResult.getEvents().size(), 1);
+
+        for (auto &completion : pool->drain())
+        {
+            completions.emplace_back(std::move(completion));
+        }
+    }
+
+    ASSERT_EQ(completions.size(), 1);
+    ASSERT_EQ(completions.front().mId, 1);
+    ASSERT_EQ(completions.front().mResult, input.size());
+    ASSERT_TRUE(completions.front().mError == ErrorCode::None);
+    ASSERT_EQ(completions.front().mErrno, 0);
+    ASSERT_EQ(std::string(completions.front().mBuffer.data(), completions.front().mBuffer.size()), input);
+
+    // Result buffers go back to the pool and are reused for writes
+    ASSERT_EQ(pool->getBuffers().available(), 0);
+    completions.clear();
+    ASSERT_EQ(pool->getBuffers().available(), 1);
+
+    auto buffer = pool->getBuffers().acquire(3);
+    std::copy_n("new", 3, buffer.data());
+    ASSERT_EQ(pool->getBuffers().available(), 0);
+    ASSERT_TRUE(pool->submitWrite(2, fileFd, 0, std::move(buffer)));
+
+    ASSERT_FALSE(epoll.wait(1000).hasError());
+    auto written = pool->drain();
+
+    ASSERT_EQ(written.size(), 1);
+    ASSERT_EQ(written.front().mId, 2);
+    ASSERT_EQ(written.front().mResult, 3);
+
+    char read_buf[READSIZE];
+    ASSERT_EQ(pread(fileFd, read_buf, READSIZE, 0), input.size());
+    ASSERT_EQ(std::string(read_buf, 3), "new");
+
+    close(fileFd);
+}
+
+TEST(EPOLL, blocking_pool_bounded)
+{
+    auto pool = BlockingPool::create(1, 1);
+    ASSERT_TRUE(pool);
+
+    std::promise<void> started;
+    std::promise<void> release;
+    auto releaseFuture = release.get_future().share();
+
+    ASSERT_TRUE(pool->submit(1, [&started, releaseFuture]() -> ssize_t {
+        started.set_value();
+        releaseFuture.wait();
+        return 0;
+    }));
+    started.get_future().wait();
+
+    // The single worker is busy, so one job may queue and the next is refused
+    ASSERT_TRUE(pool->submit(2, []() -> ssize_t { errno = EBADF; return -1; }));
+    ASSERT_FALSE(pool->submit(3, []() -> ssize_t { return 0; }));
+
+    release.set_value();
+
+    std::vector<Completion> completions;
+    while (completions.size() < 2)
+    {
+        for (auto &completion : pool->drain())
+        {
+            completions.emplace_back(std::move(completion));
+        }
+    }
+
+    ASSERT_EQ(completions[0].mId, 1);
+    ASSERT_EQ(completions[1].mId, 2);
+    ASSERT_EQ(completions[1].mResult, -1);
+    ASSERT_TRUE(completions[1].mError == ErrorCode::EbadF);
+    ASSERT_EQ(completions[1].mErrno, EBADF);
+}
+
+TEST(EPOLL, blocking_pool_keeps_errno)
+{
+    auto pool = BlockingPool::create(1, 1);
+    ASSERT_TRUE(pool);
+
+    int dirFd = open("/tmp", O_RDONLY | O_DIRECTORY);
+    ASSERT_GE(dirFd, 0);
+
+    ASSERT_TRUE(pool->submitRead(1, dirFd, 0, 64));
+
+    std::vector<Completion> completions;
+    while (completions.empty())
+    {
+        completions = pool->drain();
+    }
+
+    // EISDIR has no ErrorCode of its own, but the raw errno survives
+    ASSERT_EQ(completions.front().mResult, -1);
+    ASSERT_TRUE(completions.front().mError == ErrorCode::Unknown);
+    ASSERT_EQ(completions.front().mErrno, EISDIR);
+
+    close(dirFd);
+}
+
+TEST(EPOLL, record_and_replay)
+{
+    char path[] = "/tmp/testEpollTraceXXXXXX";
+    close(mkstemp(path));
+
+    int mypipe[2];
+    ASSERT_EQ(pipe(mypipe), 0);
+
+    auto readFd = Fd{mypipe[0]};
+    std::string input("test");
+
+    {
+        auto recorder = Recorder::open(path);
+        ASSERT_TRUE(recorder);
+
+        auto createEpoll = EpollImpl<Recorder, Fd>::epollCreate(std::move(recorder));
+        ASSERT_TRUE(createEpoll);
+
+        auto &epoll = createEpoll.getEpoll();
+
+        ASSERT_FALSE(epoll.add(readFd, EventCode::EpollIn).hasError());
+        ASSERT_EQ(epoll.wait(0).getEvents().size(), 0);
+
+        write_to_pipe(mypipe[1], input);
+        ASSERT_EQ(epoll.wait(0).getEvents().size(), 1);
+
+        ASSERT_FALSE(epoll.erase(readFd).hasError());
+        ASSERT_TRUE(epoll.erase(readFd).getError() == ErrorCode::EnoEnt);
+
+        // Closing the EpollImpl must flush the trace, even while it is still alive
+        epoll.close();
+        ASSERT_TRUE(Replay::open(path));
+    }
+
+    close(mypipe[0]);
+    close(mypipe[1]);
+
+    auto replay = Replay::open(path);
+    ASSERT_TRUE(replay);
+
+    auto createEpoll = EpollImpl<Replay, Fd>::epollCreate(std::move(replay));
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+    const auto &underlying = epoll.getUnderlying();
+
+    // The pipe is gone; the recorded outcomes stand in for the kernel
+    ASSERT_FALSE(epoll.add(readFd, EventCode::EpollIn).hasError());
+    ASSERT_EQ(epoll.wait().getEvents().size(), 0);
+
+    auto waitResult = epoll.wait();
+    ASSERT_EQ(waitResult.getEvents().size(), 1);
+    ASSERT_EQ(waitResult.getEvents().front().second.mData.fd, readFd.getFileDescriptor());
+    ASSERT_TRUE(waitResult.getEvents().front().second.mEvents & EventCode::EpollIn);
+
+    ASSERT_FALSE(epoll.erase(readFd).hasError());
+    ASSERT_TRUE(epoll.erase(readFd).getError() == ErrorCode::EnoEnt);
+
+    ASSERT_TRUE(underlying.finished());
+    ASSERT_EQ(underlying.getDivergences(), 0);
+    ASSERT_EQ(epoll.wait().getEvents().size(), 0);
+
+    unlink(path);
+}
+
+TEST(EPOLL, replay_rejects_bad_trace)
+{
+    char path[] = "/tmp/testEpollTraceXXXXXX";
+    int fd = mkstemp(path);
+    write_to_pipe(fd, "not a trace");
+    close(fd);
+
+    ASSERT_FALSE(Replay::open(path));
+    ASSERT_EQ(errno, EINVAL);
+
+    unlink(path);
+}
+
+TEST(EPOLL, batch_classifies_events)
+{
+    auto createEpoll = EpollImpl<MockEpoll, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+    auto &underlying = epoll.getUnderlying();
+
+    // More than two SIMD blocks plus a scalar tail
+    const std::vector<uint32_t> masks =
+        { EPOLLIN, EPOLLOUT, EPOLLIN | EPOLLOUT, EPOLLERR
+        , EPOLLHUP | EPOLLIN, EPOLLPRI, EPOLLOUT, 0
+        , EPOLLIN | EPOLLERR, EPOLLRDHUP, EPOLLOUT | EPOLLHUP };
+
+    EXPECT_CALL(underlying, epoll_wait(testing::_, 16, -1)).WillOnce([&](struct epoll_event *events, int, int) {
+        for (std::size_t i = 0; i < masks.size(); ++i)
+        {
+            events[i].events = masks[i];
+            events[i].data.u64 = (uint64_t{0xdeadbeef} << 32) | (100 + i);
+        }
+        return static_cast<int>(masks.size());
+    });
+
+    EventBatch batch(16);
+    auto waitResult = epoll.wait(batch);
+
+    ASSERT_FALSE(waitResult.hasError());
+    ASSERT_EQ(waitResult.getEvents().size(), 0);
+    ASSERT_EQ(batch.size(), masks.size());
+    ASSERT_EQ(batch.getMasks(), masks);
+
+    for (std::size_t i = 0; i < masks.size(); ++i)
+    {
+        ASSERT_EQ(batch.getFds()[i], 100 + i);
+    }
+
+    ASSERT_EQ(batch.getReadable(), (std::vector<uint32_t>{0, 2, 4, 5, 8}));
+    ASSERT_EQ(batch.getWritable(), (std::vector<uint32_t>{1, 2, 6, 10}));
+    ASSERT_EQ(batch.getErrors(), (std::vector<uint32_t>{3, 4, 8, 10}));
+}
+
+void fill_send_queue(EpollImpl<MockEpoll, Fd> &epoll, Fd fd)
+{
+    std::string chunk(64 * 1024, 'x');
+    while (epoll.getQueued(fd) == 0)
+    {
+        ASSERT_FALSE(epoll.send(fd, chunk.c_str(), chunk.size()).hasError());
+    }
+}
+
+TEST(EPOLL, batch_matches_wait_for_write_queues)
+{
+    auto createEpoll = EpollImpl<MockEpoll, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+    auto &underlying = epoll.getUnderlying();
+
+    auto noOut = [](struct epoll_event *ev) { return (ev->events & EPOLLOUT) == 0; };
+
+    EXPECT_CALL(underlying, epoll_ctl).Times(testing::AnyNumber());
+
+    // Peer gone: only EPOLLERR is reported for it
+    int dead[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, dead), 0);
+    set_nonblocking(dead[0]);
+
+    // Live peer: the queue-armed EPOLLOUT is the only readiness
+    int live[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, live), 0);
+    set_nonblocking(live[0]);
+    set_nonblocking(live[1]);
+
+    auto deadFd = Fd{dead[0]};
+    auto liveFd = Fd{live[0]};
+    auto readFd = Fd{live[1]};
+
+    epoll.add(deadFd, EventCode::EpollIn);
+    epoll.add(liveFd, EventCode::EpollIn);
+    epoll.add(readFd, EventCode::EpollIn);
+
+    fill_send_queue(epoll, deadFd);
+    fill_send_queue(epoll, liveFd);
+    close(dead[1]);
+
+    EXPECT_CALL(underlying, epoll_ctl(EPOLL_CTL_MOD, dead[0], testing::Truly(noOut)));
+    EXPECT_CALL(underlying, epoll_wait).WillOnce([&](struct epoll_event *events, int, int) {
+        events[0].events = EPOLLOUT;
+        events[0].data.fd = live[0];
+        events[1].events = EPOLLERR;
+        events[1].data.fd = dead[0];
+        events[2].events = EPOLLIN;
+        events[2].data.fd = live[1];
+        return 3;
+    });
+
+    EventBatch batch(8);
+    ASSERT_FALSE(epoll.wait(batch, 0).hasError());
+
+    // The error-only event flushed and cleared the dead queue
+    ASSERT_EQ(epoll.getQueued(deadFd), 0);
+
+    // The hidden EPOLLOUT left an empty event, which is dropped like wait() does
+    ASSERT_EQ(batch.size(), 2);
+    ASSERT_EQ(batch.getFds(), (std::vector<uint32_t>{static_cast<uint32_t>(dead[0]), static_cast<uint32_t>(live[1])}));
+    ASSERT_EQ(batch.getMasks(), (std::vector<uint32_t>{EPOLLERR, EPOLLIN}));
+    ASSERT_EQ(batch.getErrors(), (std::vector<uint32_t>{0}));
+    ASSERT_EQ(batch.getReadable(), (std::vector<uint32_t>{1}));
+    ASSERT_EQ(batch.getWritable().size(), 0);
+
+    close(dead[0]);
+    close(live[0]);
+    close(live[1]);
+}
+
+TEST(EPOLL, batch_wait_on_pipes)
+{
+    auto createEpoll = EpollImpl<Light, Fd>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    std::vector<int> readEnds;
+    for (int i = 0; i < 9; ++i)
+    {
+        int mypipe[2];
+        ASSERT_EQ(pipe(mypipe), 0);
+        readEnds.push_back(mypipe[0]);
+
+        ASSERT_FALSE(epoll.add(Fd{mypipe[0]}, EventCode::EpollIn).hasError());
+        ASSERT_FALSE(epoll.add(Fd{mypipe[1]}, EventCode::EpollOut).hasError());
+
+        if (i % 2 == 0)
+        {
+            write_to_pipe(mypipe[1], "test");
+        }
+    }
+
+    EventBatch batch;
+    ASSERT_FALSE(epoll.wait(batch, 0).hasError());
+
+    ASSERT_EQ(batch.size(), 9 + 5);
+    ASSERT_EQ(batch.getReadable().size(), 5);
+    ASSERT_EQ(batch.getWritable().size(), 9);
+    ASSERT_EQ(batch.getErrors().size(), 0);
+
+    for (auto idx : batch.getReadable())
+    {
+        ASSERT_NE(std::find(readEnds.begin(), readEnds.end(), batch.getFds()[idx]), readEnds.end());
+        ASSERT_TRUE(batch.getMasks()[idx] & EPOLLIN);
+    }
+}
+
+struct TaggedFd
+{
+    int32_t fd;
+    uint64_t tag;
+
+    public:
+    int32_t getFileDescriptor() const
+    {
+        return fd;
+    }
+};
+
+TEST(EPOLL, export_reports_queued_bytes)
+{
+    auto createEpoll = EpollImpl<Light, TaggedFd>::epollCreate();
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    set_nonblocking(sockets[0]);
+
+    auto writer = TaggedFd{sockets[0], 0};
+    ASSERT_FALSE(epoll.add(writer, EventCode::EpollIn).hasError());
+    ASSERT_FALSE(epoll.add(TaggedFd{sockets[1], 1}, EventCode::EpollIn).hasError());
+
+    std::string chunk(64 * 1024, 'x');
+    while (epoll.getQueued(writer) == 0)
+    {
+        ASSERT_FALSE(epoll.send(writer, chunk.c_str(), chunk.size()).hasError());
+    }
+
+    auto registrations = epoll.exportRegistry([](const TaggedFd &fdObj) { return fdObj.tag; });
+    ASSERT_EQ(registrations.size(), 2);
+
+    for (const auto &reg : registrations)
+    {
+        ASSERT_EQ(reg.mQueued, reg.mTag == 0 ? epoll.getQueued(writer) : 0);
+    }
+
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+TEST(EPOLL, handoff_to_child_process)
+{
+    constexpr int COUNT = 512;
+    constexpr int SIGNALLED = 7;
+
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets), 0);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0)
+    {
+        // Successor: only plain checks here, gtest belongs to the parent
+        close(sockets[0]);
+
+        std::vector<Registration> registrations;
+        if (receiveRegistrations(sockets[1], registrations) != ErrorCode::None
+            || registrations.size() != COUNT)
+        {
+            _exit(1);
+        }
+
+        auto createEpoll = EpollImpl<Light, TaggedFd>::epollCreate();
+        auto &epoll = createEpoll.getEpoll();
+
+        auto imported = epoll.importRegistry(registrations, [](int32_t fd, uint64_t tag) {
+            return TaggedFd{fd, tag};
+        });
+        if (imported.hasError())
+        {
+            _exit(2);
+        }
+
+        char ack = 1;
+        write(sockets[1], &ack, 1);
+
+        auto events = epoll.wait(1000).getEvents();
+        if (events.size() != 1 || events.front().first.tag != SIGNALLED
+            || !(events.front().second.mEvents & EventCode::EpollIn))
+        {
+            _exit(3);
+        }
+
+        _exit(0);
+    }
+
+    close(sockets[1]);
+
+    auto createEpoll = EpollImpl<Light, TaggedFd>::epollCreate();
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    std::vector<int> fds;
+    for (int i = 0; i < COUNT; ++i)
+    {
+        int fd = eventfd(0, EFD_NONBLOCK);
+        ASSERT_GE(fd, 0);
+        fds.push_back(fd);
+        ASSERT_FALSE(epoll.add(TaggedFd{fd, static_cast<uint64_t>(i)}, EventCode::EpollIn).hasError());
+    }
+
+    auto registrations = epoll.exportRegistry([](const TaggedFd &fdObj) { return fdObj.tag; });
+    ASSERT_EQ(registrations.size(), COUNT);
+
+    auto sendStart = std::chrono::steady_clock::now();
+    ASSERT_TRUE(sendRegistrations(sockets[0], registrations) == ErrorCode::None);
+
+    char ack;
+    ASSERT_EQ(read(sockets[0], &ack, 1), 1);
+    auto handoff = std::chrono::steady_clock::now() - sendStart;
+
+    std::cout << "handoff of " << COUNT << " fds took "
+              << std::chrono::duration_cast<std::chrono::microseconds>(handoff).count() << "us ("
+              << std::chrono::duration_cast<std::chrono::microseconds>(sendStart - start).count()
+              << "us to register and export)" << std::endl;
+
+    // The child watches the very same eventfds
+    uint64_t one = 1;
+    ASSERT_EQ(write(fds[SIGNALLED], &one, sizeof(one)), sizeof(one));
+
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    for (auto fd : fds)
+    {
+        close(fd);
+    }
+    close(sockets[0]);
+}
+
+void send_with_fds(int socket, const void *data, std::size_t size, const std::vector<int> &fds)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(data);
+    iov.iov_len = size;
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * 4)];
+
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    auto *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    ASSERT_EQ(sendmsg(socket, &msg, 0), static_cast<ssize_t>(size));
+}
+
+int count_open_fds()
+{
+    int count = 0;
+    for ([[maybe_unused]] auto &entry : std::filesystem::directory_iterator("/proc/self/fd"))
+    {
+        ++count;
+    }
+    return count;
+}
+
+TEST(EPOLL, handoff_rolls_back_on_error)
+{
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets), 0);
+
+    int passed = eventfd(0, EFD_NONBLOCK);
+    ASSERT_GE(passed, 0);
+
+    std::vector<Registration> registrations{Registration{passed, static_cast<EventCodeMask>(EventCode::EpollIn), 42, 0}};
+    auto before = count_open_fds();
+
+    // A header must not carry fds
+    uint64_t total = 4;
+    send_with_fds(sockets[0], &total, sizeof(total), {passed});
+
+    ASSERT_TRUE(receiveRegistrations(sockets[1], registrations) == ErrorCode::Einval);
+    ASSERT_EQ(registrations.size(), 1);
+    ASSERT_EQ(count_open_fds(), before);
+
+    // One good batch, then the sender goes away before the rest
+    ASSERT_EQ(send(sockets[0], &total, sizeof(total), 0), static_cast<ssize_t>(sizeof(total)));
+
+    // Two wire entries: tag, then events and a reserved word
+    uint64_t entries[4] = {1, 0, 2, 0};
+    send_with_fds(sockets[0], entries, sizeof(entries), {passed, passed});
+    shutdown(sockets[0], SHUT_WR);
+
+    ASSERT_TRUE(receiveRegistrations(sockets[1], registrations) == ErrorCode::Einval);
+    ASSERT_EQ(registrations.size(), 1);
+    ASSERT_EQ(registrations.front().mTag, 42);
+    ASSERT_EQ(count_open_fds(), before);
+
+    // An implausible count is an error, not an allocation
+    int bogus[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, bogus), 0);
+
+    total = uint64_t{1} << 42;
+    ASSERT_EQ(send(bogus[0], &total, sizeof(total), 0), static_cast<ssize_t>(sizeof(total)));
+    shutdown(bogus[0], SHUT_WR);
+
+    ASSERT_TRUE(receiveRegistrations(bogus[1], registrations) == ErrorCode::Einval);
+    ASSERT_EQ(registrations.size(), 1);
+
+    close(bogus[0]);
+    close(bogus[1]);
+
+    close(passed);
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+TEST(EPOLL, integral_fd_type)
+{
+    auto createEpoll = EpollImpl<Light, int>::epollCreate();
+
+    ASSERT_FALSE(createEpoll.hasError());
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+
+    int mypipe[2];
+    ASSERT_EQ(pipe(mypipe), 0);
+
+    ASSERT_FALSE(epoll.add(mypipe[0], EventCode::EpollIn).hasError());
+    ASSERT_EQ(epoll.getFd(mypipe[0]), mypipe[0]);
+
+    write_to_pipe(mypipe[1], "test");
+
+    auto waitResult = epoll.wait(0);
+    ASSERT_EQ(waitResult.getEvents().size(), 1);
+    ASSERT_EQ(waitResult.getEvents().front().first, mypipe[0]);
+
+    ASSERT_FALSE(epoll.erase(mypipe[0]).hasError());
+    ASSERT_EQ(epoll.getFd(mypipe[0]), 0);
+}
+
+TEST(EPOLL, replay_resyncs_after_divergence)
+{
+    char path[] = "/tmp/testEpollTraceXXXXXX";
+    close(mkstemp(path));
+
+    int mypipe[2];
+    ASSERT_EQ(pipe(mypipe), 0);
+
+    auto fd1 = Fd{mypipe[0]};
+    auto fd2 = Fd{mypipe[1]};
+
+    {
+        auto createEpoll = EpollImpl<Recorder, Fd>::epollCreate(Recorder::open(path));
+        ASSERT_TRUE(createEpoll);
+
+        auto &epoll = createEpoll.getEpoll();
+
+        ASSERT_FALSE(epoll.add(fd1, EventCode::EpollIn).hasError());
+        ASSERT_FALSE(epoll.add(fd2, EventCode::EpollOut).hasError());
+        ASSERT_FALSE(epoll.erase(fd1).hasError());
+        ASSERT_TRUE(epoll.erase(fd1).getError() == ErrorCode::EnoEnt);
+
+        epoll.close();
+    }
+
+    close(mypipe[0]);
+    close(mypipe[1]);
+
+    auto createEpoll = EpollImpl<Replay, Fd>::epollCreate(Replay::open(path));
+    ASSERT_TRUE(createEpoll);
+
+    auto &epoll = createEpoll.getEpoll();
+    const auto &underlying = epoll.getUnderlying();
+
+    // The application no longer registers fd1: one skipped add, then back in step
+    ASSERT_FALSE(epoll.add(fd2, EventCode::EpollOut).hasError());
+    ASSERT_EQ(underlying.getDivergences(), 1);
+
+    // A call that never happened in the trace doesn't move the position
+    ASSERT_FALSE(epoll.mod(fd2, EventCode::EpollIn).hasError());
+    ASSERT_EQ(underlying.getDivergences(), 2);
+
+    ASSERT_FALSE(epoll.add(fd1, EventCode::EpollIn).hasError());
+    ASSERT_EQ(underlying.getDivergences(), 3);
+
+    ASSERT_FALSE(epoll.erase(fd1).hasError());
+    ASSERT_TRUE(epoll.erase(fd1).getError() == ErrorCode::EnoEnt);
+    ASSERT_EQ(underlying.getDivergences(), 3);
+
+    unlink(path);
+}